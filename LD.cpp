@@ -30,7 +30,9 @@ void printHelp(void){
   cerr << endl;
   
   cerr << "INFO: required: t,target     -- argument: a zero base comma seperated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: b,background -- argument: a zero base comma seperated list of background individuals corrisponding to VCF columns    " << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
   cerr << "INFO: required: f,file       -- argument: a properly formatted phased VCF file                                                       " << endl;
   cerr << "INFO: required: y,type       -- argument: type of genotype likelihood: PL, GL or GP                                                  " << endl;
   cerr << "INFO: optional: w,window     -- argument: window size to average LD; default is 1000                                                 " << endl;
@@ -125,14 +127,14 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<double
 }
 
 void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
+
+  // missing calls carry the reference allele
+
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    haplotypes[indIndex][0] += char('0' + gtFirst(*ind));
+    haplotypes[indIndex][1] += char('0' + gtSecond(*ind));
     indIndex += 1;
   }
 }
@@ -158,6 +160,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -188,7 +194,9 @@ int main(int argc, char** argv) {
 	{"help"        , 0, 0, 'h'},
         {"file"        , 1, 0, 'f'},
 	{"target"      , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background"  , 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"region"      , 1, 0, 'r'},
 	{"type"        , 1, 0, 'y'},
 	{"window"      , 1, 0, 'w'},
@@ -202,7 +210,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "w:y:r:t:b:f:edhv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "w:y:r:t:b:f:edhvT:B:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -219,6 +227,18 @@ int main(int argc, char** argv) {
 	      type = optarg;
 	      break;
 	    }
+	  case 'T':
+	    {
+	      loadSampleFile(optarg, targetNames);
+	      cerr << "INFO: target sample file: " << optarg << endl;
+	      break;
+	    }
+	  case 'B':
+	    {
+	      loadSampleFile(optarg, backgroundNames);
+	      cerr << "INFO: background sample file: " << optarg << endl;
+	      break;
+	    }
 	  case 't':
 	    {
 	      loadIndices(it, optarg);
@@ -286,6 +306,8 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     if(filename == "NA"){
       cerr << "FATAL: did not specify a file" << endl;
       printHelp();
@@ -311,17 +333,20 @@ int main(int argc, char** argv) {
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, ib, backgroundNames, "background");
+
     vector<int> target_h, background_h;
 
-    int index, indexi = 0;
+    int index = 0, indexi = 0;
 
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
      
-      if(it.find(index) != it.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
-      if(ib.find(index) != ib.end()){
+      if(backgroundMember[index]){
 	background_h.push_back(indexi);
 	indexi++;
       }
@@ -336,6 +361,14 @@ int main(int argc, char** argv) {
     
     string currentSeqid = "NA";
     
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget     = newGenotype(format);
+    genotype * populationBackground = newGenotype(format);
+    genotype * populationTotal      = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
 
       if(!var.isPhased()){
@@ -359,44 +392,30 @@ int main(int argc, char** argv) {
 	backgroundAFS.clear();
       }
       
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
       
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 
-	if(it.find(sindex) != it.end() ){
-	  target.push_back(sample);
-	  total.push_back(sample);	  
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
-	if(ib.find(sindex) != ib.end()){
-	  background.push_back(sample);
-	  total.push_back(sample);	  
+	if(backgroundMember[sindex]){
+	  background.push_back(&sample);
+	  total.push_back(&sample);	  
 	}	
 	sindex += 1;
       }
       
-      genotype * populationTarget    ;
-      genotype * populationBackground;
-      genotype * populationTotal     ;
-      
-      if(type == "PL"){
-	populationTarget     = new pl();
-	populationBackground = new pl();
-	populationTotal      = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-	populationBackground = new gl();
-	populationTotal      = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-	populationBackground = new gp();
-	populationTotal      = new gp();
-      }
+      populationTarget->reset();
+      populationBackground->reset();
+      populationTotal->reset();
       
       populationTarget->loadPop(target,         var.sequenceName, var.position);
       
@@ -418,5 +437,9 @@ int main(int argc, char** argv) {
 
     calc(haplotypes, nsamples, positions, targetAFS, backgroundAFS, external, derived, windowSize, target_h, background_h, currentSeqid);
     
+    delete populationTarget;
+    delete populationBackground;
+    delete populationTotal;
+
     return 0;		    
 }
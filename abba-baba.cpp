@@ -6,6 +6,8 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <math.h>  
 #include <cmath>
 #include <stdlib.h>
@@ -46,13 +48,37 @@ void printHelp(void){
   cerr << "     1. seqid            "    << endl;
   cerr << "     2. position         "    << endl;
   cerr << "     3. abba             "    << endl;
-  cerr << "     4. baba             "    << endl;
+  cerr << "     4. baba             "    << endl << endl;
+
+  cerr << "Output with --quartets : 11 columns, one line per quartet after the whole file : " << endl;
+  cerr << "     1.  quartet (A,B,C,D)                        " << endl;
+  cerr << "     2.  abba sites                               " << endl;
+  cerr << "     3.  baba sites                               " << endl;
+  cerr << "     4.  sites with all four taxa called          " << endl;
+  cerr << "     5.  jackknife blocks                         " << endl;
+  cerr << "     6.  D (abba - baba) / (abba + baba)          " << endl;
+  cerr << "     7.  block jackknife standard error of D      " << endl;
+  cerr << "     8.  Z score of D                             " << endl;
+  cerr << "     9.  f4 (abba - baba) / sites                 " << endl;
+  cerr << "     10. block jackknife standard error of f4     " << endl;
+  cerr << "     11. Z score of f4                            " << endl << endl;
 
   cerr << "INFO: usage:  abba-baba --tree 0,1,2,3 --file my.vcf --type PL" << endl;
   cerr << endl;
   cerr << "INFO: required: t,tree       -- a zero based comma seperated list of target individuals corrisponding to VCF columns" << endl;
+  cerr << "                                optional with --quartets, which it joins as one more quartet; not used with --pop-a..d" << endl;
+  cerr << "INFO: optional: q,quartets   -- a file of trees, one per line in the --tree format; reports D and f4 per quartet  " << endl;
+  cerr << "                                instead of per site lines; replaces --tree as the required option; not used with --pop-a..d" << endl;
+  cerr << "INFO: optional: k,block      -- jackknife block size in bp for --quartets and the populations [5000000]             " << endl;
+  cerr << "INFO: optional: A,pop-a      -- a zero based comma seperated list of individuals for taxon A; with B, C and D gives  " << endl;
+  cerr << "                                a single line of allele frequency D (Durand et al. 2011) in the --quartets format     " << endl;
+  cerr << "INFO: optional: B,pop-b      -- individuals for taxon B                                                              " << endl;
+  cerr << "INFO: optional: C,pop-c      -- individuals for taxon C                                                              " << endl;
+  cerr << "INFO: optional: D,pop-d      -- individuals for taxon D                                                              " << endl;
+  cerr << "                                frequencies are from hard calls with --type GT, otherwise from expected dosages      " << endl;
+  cerr << "                                the four populations replace --tree and cannot be combined with --tree or --quartets " << endl;
   cerr << "INFO: required: f,file       -- a properly formatted VCF.                                                           " << endl;
-  cerr << "INFO: required: y,type       -- genotype likelihood format ; genotypes: GP,GL or PL;                                " << endl;
+  cerr << "INFO: required: y,type       -- genotype likelihood format ; genotypes: GT,GP,GL or PL;                             " << endl;
   cerr << endl;
 
   printVersion() ;
@@ -74,6 +100,7 @@ random sampling adds noise but will not affect the overall measurement
 of D-statistic */
 int  sample_het(int &rv){
   rv = rand() % 2 ; // pick from 0/1 het with 50-50 odds
+  return rv;
 }
 
 
@@ -121,6 +148,163 @@ int  containsRef(string gt){
   return 0;
 }
 
+int missingGT(string gt){
+  return gt == "./." || gt == ".|." || gt == ".";
+}
+
+// the site pattern of one quartet given the alt state of each taxon
+
+void abbaBaba(int A, int B, int C, int D, double & abba, double & baba){
+
+  abba = 0;
+  baba = 0;
+
+  if(D == 1 && C == 0 && B == 0 && A == 1){
+    abba = 1;
+  }
+  if(D == 0 && C == 1 && B == 0 && A == 1){
+    baba = 1;
+  }
+
+  if(D == 0 && C == 1 && B == 1 && A == 0){
+    abba = 1;
+  }
+  if(D == 1 && C == 0 && B == 1 && A == 0){
+    baba = 1;
+  }
+}
+
+// The expected site patterns of allele frequencies p1..p4 (Durand et al.
+// 2011), counting both polarisations as the hard call patterns do; with
+// frequencies of 0 or 1 they reduce to abbaBaba.
+
+void frequencyPattern(double p1, double p2, double p3, double p4, double & abba, double & baba){
+  abba = (1 - p1) * p2 * p3 * (1 - p4) + p1 * (1 - p2) * (1 - p3) * p4;
+  baba = p1 * (1 - p2) * p3 * (1 - p4) + (1 - p1) * p2 * (1 - p3) * p4;
+}
+
+// ABBA and BABA counts of one quartet, in total and per jackknife block;
+// sites counts every site where all four taxa were called.  With
+// populations the counts are the expected patterns from allele frequencies.
+
+struct quartet{
+  string         name;
+  int            taxa[4];
+  double         abba;
+  double         baba;
+  double         sites;
+  vector<double> blockAbba;
+  vector<double> blockBaba;
+  vector<double> blockSites;
+};
+
+void startBlock(quartet & q){
+  q.blockAbba.push_back(0);
+  q.blockBaba.push_back(0);
+  q.blockSites.push_back(0);
+}
+
+void addSite(quartet & q, double abba, double baba){
+  q.abba  += abba;
+  q.baba  += baba;
+  q.sites += 1;
+
+  q.blockAbba.back()  += abba;
+  q.blockBaba.back()  += baba;
+  q.blockSites.back() += 1;
+}
+
+// Delete-one-block jackknife of a ratio of sums, sum(num) / sum(den).
+// Blocks without any sites are left out; fewer than two blocks, or a
+// block holding every site, leaves the standard error undefined (-1).
+
+void jackknife(vector<double> & num, vector<double> & den, vector<double> & sites,
+	       double & estimate, double & se, int & nblocks){
+
+  double totalNum = 0;
+  double totalDen = 0;
+
+  for(unsigned int b = 0; b < num.size(); b++){
+    totalNum += num[b];
+    totalDen += den[b];
+  }
+
+  estimate = totalDen > 0 ? totalNum / totalDen : 0;
+  se       = -1;
+
+  vector<double> partial;
+
+  bool defined = true;
+
+  for(unsigned int b = 0; b < num.size(); b++){
+    if(sites[b] == 0){
+      continue;
+    }
+    if(totalDen - den[b] <= 0){
+      defined = false;
+      partial.push_back(0);
+      continue;
+    }
+    partial.push_back((totalNum - num[b]) / (totalDen - den[b]));
+  }
+
+  nblocks = partial.size();
+
+  if(!defined || nblocks < 2){
+    return;
+  }
+
+  double mean = 0;
+  for(int b = 0; b < nblocks; b++){
+    mean += partial[b];
+  }
+  mean /= nblocks;
+
+  double ss = 0;
+  for(int b = 0; b < nblocks; b++){
+    ss += (partial[b] - mean) * (partial[b] - mean);
+  }
+  se = sqrt(ss * (nblocks - 1) / nblocks);
+}
+
+void reportQuartet(quartet & q){
+
+  vector<double> diff(q.blockAbba.size()), sum(q.blockAbba.size());
+
+  for(unsigned int b = 0; b < q.blockAbba.size(); b++){
+    diff[b] = q.blockAbba[b] - q.blockBaba[b];
+    sum[b]  = q.blockAbba[b] + q.blockBaba[b];
+  }
+
+  double d, dSE, f4, f4SE;
+  int    nblocks, f4blocks;
+
+  jackknife(diff, sum,          q.blockSites, d,  dSE,  nblocks);
+  jackknife(diff, q.blockSites, q.blockSites, f4, f4SE, f4blocks);
+
+  cout << q.name << "\t" << q.abba << "\t" << q.baba << "\t" << q.sites << "\t" << nblocks;
+
+  if(q.abba + q.baba == 0){
+    cout << "\tNA\tNA\tNA";
+  }
+  else if(dSE <= 0){
+    cout << "\t" << d << "\tNA\tNA";
+  }
+  else{
+    cout << "\t" << d << "\t" << dSE << "\t" << d / dSE;
+  }
+
+  if(q.sites == 0){
+    cout << "\tNA\tNA\tNA" << endl;
+  }
+  else if(f4SE <= 0){
+    cout << "\t" << f4 << "\tNA\tNA" << endl;
+  }
+  else{
+    cout << "\t" << f4 << "\t" << f4SE << "\t" << f4 / f4SE << endl;
+  }
+}
+
 void loadIndices(vector<int> & tree, string set){
   
   vector<string>  indviduals = split(set, ",");
@@ -137,6 +321,60 @@ void loadIndices(vector<int> & tree, string set){
   }
 }
 
+quartet newQuartet(vector<int> & tree){
+
+  quartet q;
+
+  stringstream name;
+  name << tree[0] << "," << tree[1] << "," << tree[2] << "," << tree[3];
+
+  q.name = name.str();
+  for(int i = 0; i < 4; i++){
+    q.taxa[i] = tree[i];
+  }
+  q.abba  = 0;
+  q.baba  = 0;
+  q.sites = 0;
+
+  return q;
+}
+
+void loadGroup(map<int, int> & index, string set){
+
+  vector<string>  indviduals = split(set, ",");
+
+  for(vector<string>::iterator it = indviduals.begin(); it != indviduals.end(); it++){
+    index[ atoi( (*it).c_str() ) ] = 1;
+  }
+}
+
+// one quartet per line in the --tree format; blank lines are skipped
+
+void loadQuartets(vector<quartet> & quartets, string filename){
+
+  ifstream quartetFile(filename.c_str());
+
+  if(!quartetFile.is_open()){
+    cerr << "FATAL: could not open quartet file: " << filename << endl;
+    exit(1);
+  }
+
+  string line;
+
+  while(getline(quartetFile, line)){
+
+    if(line.find_first_not_of(" \t\r") == string::npos){
+      continue;
+    }
+
+    vector<int> tree;
+    loadIndices(tree, line);
+
+    quartets.push_back(newQuartet(tree));
+  }
+  cerr << "INFO: there are " << quartets.size() << " quartets in " << filename << endl;
+}
+
 int main(int argc, char** argv) {
 
   // pooled or genotyped
@@ -172,6 +410,17 @@ int main(int argc, char** argv) {
 
   string type = "NA";
 
+  // quartets summarised in one pass, with jackknife blocks of this many bp
+
+  vector<quartet> quartets;
+
+  long int block = 5000000;
+
+  // sample groups for the allele frequency D, in --tree order
+
+  vector< map<int, int> > groups(4);
+  vector<string>          groupNames(4, "NA");
+
     const struct option longopts[] = 
       {
 	{"version"   , 0, 0, 'v'},
@@ -182,6 +431,12 @@ int main(int argc, char** argv) {
 	{"background", 1, 0, 'b'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
+	{"quartets"  , 1, 0, 'q'},
+	{"block"     , 1, 0, 'k'},
+	{"pop-a"     , 1, 0, 'A'},
+	{"pop-b"     , 1, 0, 'B'},
+	{"pop-c"     , 1, 0, 'C'},
+	{"pop-d"     , 1, 0, 'D'},
 	{0,0,0,0}
       };
 
@@ -190,7 +445,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "r:d:t:f:y:hv", longopts, &index);
+	iarg = getopt_long(argc, argv, "r:d:t:f:y:q:k:A:B:C:D:hv", longopts, &index);
 	
 	switch (iarg)
 	  {
@@ -207,6 +462,21 @@ int main(int argc, char** argv) {
 	  case 't':
 	    loadIndices(tree, optarg);
 	    break;
+	  case 'q':
+	    loadQuartets(quartets, optarg);
+	    break;
+	  case 'A':
+	  case 'B':
+	  case 'C':
+	  case 'D':
+	    loadGroup(groups[iarg - 'A'], optarg);
+	    groupNames[iarg - 'A'] = optarg;
+	    cerr << "INFO: population " << char(iarg) << ": " << optarg << endl;
+	    break;
+	  case 'k':
+	    block = atol(optarg);
+	    cerr << "INFO: jackknife block size: " << block << endl;
+	    break;
 	  case 'f':
 	    cerr << "INFO: File: " << optarg  <<  endl;
 	    filename = optarg;
@@ -242,6 +512,7 @@ int main(int argc, char** argv) {
     okayGenotypeLikelihoods["PO"] = 1;
     okayGenotypeLikelihoods["GL"] = 1;
     okayGenotypeLikelihoods["GP"] = 1;
+    okayGenotypeLikelihoods["GT"] = 1;
 
 
     if(type == "NA"){
@@ -261,6 +532,188 @@ int main(int argc, char** argv) {
 
     srand(time(0)); //initialize random number generator
 
+    int format = formatType(type);
+
+    if(block < 1){
+      cerr << "FATAL: the jackknife block size must be positive" << endl;
+      return 1;
+    }
+
+    // D from the allele frequencies of four sample groups: hard calls with
+    // --type GT, otherwise the expected dosages under the likelihoods
+
+    if(groupNames[0] != "NA" || groupNames[1] != "NA" || groupNames[2] != "NA" || groupNames[3] != "NA"){
+
+      if(groupNames[0] == "NA" || groupNames[1] == "NA" || groupNames[2] == "NA" || groupNames[3] == "NA"){
+	cerr << "FATAL: population D requires all four of --pop-a, --pop-b, --pop-c and --pop-d" << endl;
+	printHelp();
+	return 1;
+      }
+      if(!tree.empty() || !quartets.empty()){
+	cerr << "FATAL: --pop-a..d cannot be combined with --tree or --quartets" << endl;
+	printHelp();
+	return 1;
+      }
+
+      vector<string> noNames;
+
+      vector< vector<char> >                                   members(4);
+      vector< vector< map< string, vector<string> > * > >      samples(4);
+      vector<genotype *>                                       pops(4);
+
+      for(int g = 0; g < 4; g++){
+	members[g] = sampleMembership(sampleNames, groups[g], noNames, string("pop-") + char('a' + g));
+	pops[g]    = newGenotype(format);
+	if(pops[g] == NULL){
+	  cerr << "FATAL: population D needs genotypes or likelihoods: GT, GL, GP or PL" << endl;
+	  return 1;
+	}
+      }
+
+      quartet q;
+      q.name  = groupNames[0] + ";" + groupNames[1] + ";" + groupNames[2] + ";" + groupNames[3];
+      q.abba  = 0;
+      q.baba  = 0;
+      q.sites = 0;
+
+      string   blockSeqid = "NA";
+      long int blockIndex = -1;
+
+      int nsamples = sampleNames.size();
+
+      while (variantFile.getNextVariant(var)) {
+
+	if(var.alt.size() > 1){
+	  continue;
+	}
+
+	if(var.sequenceName != blockSeqid || var.position / block != blockIndex){
+	  blockSeqid = var.sequenceName;
+	  blockIndex = var.position / block;
+	  startBlock(q);
+	}
+
+	double p[4];
+	bool   called = true;
+
+	for(int g = 0; g < 4; g++){
+
+	  samples[g].clear();
+
+	  for(int i = 0; i < nsamples; i++){
+	    if(members[g][i]){
+	      samples[g].push_back(&var.samples[sampleNames[i]]);
+	    }
+	  }
+
+	  pops[g]->reset();
+	  pops[g]->loadPop(samples[g], var.sequenceName, var.position);
+
+	  if(pops[g]->af == -1){
+	    called = false;
+	    break;
+	  }
+	  p[g] = pops[g]->eaf;
+	}
+
+	if(!called){
+	  continue;
+	}
+
+	double abba, baba;
+	frequencyPattern(p[0], p[1], p[2], p[3], abba, baba);
+
+	addSite(q, abba, baba);
+      }
+
+      reportQuartet(q);
+
+      for(int g = 0; g < 4; g++){
+	delete pops[g];
+      }
+      return 0;
+    }
+
+    if(!quartets.empty()){
+
+      // a --tree quartet joins the list
+
+      if(!tree.empty()){
+	quartets.push_back(newQuartet(tree));
+      }
+
+      // each taxon is decoded once per site, whatever the number of quartets
+
+      int nsamples = sampleNames.size();
+
+      vector<char> used(nsamples, 0);
+
+      for(vector<quartet>::iterator q = quartets.begin(); q != quartets.end(); q++){
+	for(int i = 0; i < 4; i++){
+	  if(q->taxa[i] < 0 || q->taxa[i] >= nsamples){
+	    cerr << "FATAL: quartet index out of range: " << q->taxa[i] << endl;
+	    return 1;
+	  }
+	  used[q->taxa[i]] = 1;
+	}
+      }
+
+      vector<int>  state(nsamples, 0);
+      vector<char> missing(nsamples, 0);
+
+      string   blockSeqid = "NA";
+      long int blockIndex = -1;
+
+      while (variantFile.getNextVariant(var)) {
+
+	if(var.alt.size() > 1){
+	  continue;
+	}
+
+	if(var.sequenceName != blockSeqid || var.position / block != blockIndex){
+	  blockSeqid = var.sequenceName;
+	  blockIndex = var.position / block;
+	  for(vector<quartet>::iterator q = quartets.begin(); q != quartets.end(); q++){
+	    startBlock(*q);
+	  }
+	}
+
+	for(int i = 0; i < nsamples; i++){
+	  if(!used[i]){
+	    continue;
+	  }
+	  string & gt = var.samples[sampleNames[i]]["GT"].front();
+	  missing[i]  = missingGT(gt);
+	  state[i]    = missing[i] ? 0 : containsAlt(gt);
+	}
+
+	for(vector<quartet>::iterator q = quartets.begin(); q != quartets.end(); q++){
+
+	  int * t = q->taxa;
+
+	  if(missing[t[0]] || missing[t[1]] || missing[t[2]] || missing[t[3]]){
+	    continue;
+	  }
+
+	  double abba, baba;
+	  abbaBaba(state[t[0]], state[t[1]], state[t[2]], state[t[3]], abba, baba);
+
+	  addSite(*q, abba, baba);
+	}
+      }
+
+      for(vector<quartet>::iterator q = quartets.begin(); q != quartets.end(); q++){
+	reportQuartet(*q);
+      }
+      return 0;
+    }
+
+    if(tree.size() < 4){
+      cerr << "FATAL: the tree option is required without --quartets" << endl;
+      printHelp();
+      return 1;
+    }
+
     while (variantFile.getNextVariant(var)) {
 
       if(var.alt.size() > 1){
@@ -288,19 +741,7 @@ int main(int argc, char** argv) {
       C = containsAlt(tC["GT"].front());
       D = containsAlt(tD["GT"].front());
 
-      if(D == 1 && C == 0 && B == 0 && A == 1){
-	abba = 1;
-      }
-      if(D == 0 && C == 1 && B == 0 && A == 1){
-	baba = 1;
-      }
-
-      if(D == 0 && C == 1 && B == 1 && A == 0){
-        abba = 1;
-      }
-      if(D == 1 && C == 0 && B == 1 && A == 0){
-	baba = 1;
-      }
+      abbaBaba(A, B, C, D, abba, baba);
 
 
       if(abba == 0 && baba == 0){
@@ -1,8 +1,10 @@
 #include "Variant.h"
 #include "split.h"
+#include "var.h"
 #include "pdflib.h"
 
 #include <string>
+#include <algorithm>
 #include <iostream>
 #include <math.h>  
 #include <cmath>
@@ -354,6 +356,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -366,7 +372,9 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"deltaaf"   , 1, 0, 'd'},
 	{0,0,0,0}
       };
@@ -376,7 +384,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "d:t:b:f:hv", longopts, &index);
+	iarg = getopt_long(argc, argv, "d:t:b:f:hvT:B:", longopts, &index);
 	
 	switch (iarg)
 	  {
@@ -410,7 +418,9 @@ int main(int argc, char** argv) {
 	    cerr << "INFO: usage:  bFst --target 0,1,2,3,4,5,6,7 --background 11,12,13,16,17,19,22 --file my.vcf --deltaaf 0.1" << endl;
 	    cerr << endl;
 	    cerr << "INFO: required: t,target     -- a zero bases comma separated list of target individuals corrisponding to VCF columns" << endl;
+	    cerr << "INFO: optional: T,target-file -- a file of target sample names, one per line; adds to --target" << endl;
 	    cerr << "INFO: required: b,background -- a zero bases comma separated list of background individuals corrisponding to VCF columns" << endl;
+	    cerr << "INFO: optional: B,background-file -- a file of background sample names, one per line; adds to --background" << endl;
 	    cerr << "INFO: required: f,file a     -- a proper formatted VCF file.  the FORMAT field MUST contain \"PL\"" << endl; 
 	    cerr << "INFO: required: d,deltaaf    -- skip sites were the difference in allele frequency is less than deltaaf" << endl;
 	    cerr << endl; 
@@ -422,6 +432,16 @@ int main(int argc, char** argv) {
 	    cerr << "INFO: version 1.0.0 ; date: April 2014 ; author: Zev Kronenberg; email : zev.kronenberg@utah.edu "  << endl;
 	    return 0;
 
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
+
 	  case 't':
 	    loadIndices(ib, optarg);
 	    cerr << "INFO: There are " << ib.size() << " individuals in the target" << endl;
@@ -479,23 +499,28 @@ int main(int argc, char** argv) {
       cerr << endl;
       return(1);
     }
-    if(it.size() < 2){
+    Variant var(variantFile);
+
+    vector<string> samples = variantFile.sampleNames;
+    int nsamples = samples.size();
+
+    vector<char> targetMember     = sampleMembership(samples, ib, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, it, backgroundNames, "background");
+
+    if(count(targetMember.begin(), targetMember.end(), 1) < 2){
       cerr << endl;
       cerr << "FATAL: target not specified or less than two indviduals" << endl; 
       cerr << "INFO:  please use bFst --help                          " << endl; 
       cerr << endl;
+      return(1);
     }
-    if(ib.size() < 2){
+    if(count(backgroundMember.begin(), backgroundMember.end(), 1) < 2){
       cerr << endl;
-      cerr << "FATAL: target not specified or less than two indviduals"<< endl;
+      cerr << "FATAL: background not specified or less than two indviduals"<< endl;
       cerr << "INFO:  please use bFst --help                          " << endl;
       cerr << endl;
+      return(1);
     }
-    
-    Variant var(variantFile);
-
-    vector<string> samples = variantFile.sampleNames;
-    int nsamples = samples.size();
 
     while (variantFile.getNextVariant(var)) {
         
@@ -515,12 +540,12 @@ int main(int argc, char** argv) {
           map<string, vector<string> > sample = var.samples[ samples[nsamp]];
 	  
 	  if(sample["GT"].front() != "./."){
-	    if(it.find(index) != it.end() ){
+	    if(backgroundMember[index]){
 	      target.push_back(sample);
 	      total.push_back(sample);
 	      
 	    }
-	    if(ib.find(index) != ib.end()){
+	    if(targetMember[index]){
 		background.push_back(sample);
 		total.push_back(sample);
 	    }
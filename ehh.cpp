@@ -0,0 +1,533 @@
+#include "Variant.h"
+#include "split.h"
+#include "cdflib.h"
+#include "pdflib.h"
+#include "var.h"
+#include "phaselib.h"
+#include "ehhlib.h"
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <math.h>
+#include <cmath>
+#include <stdlib.h>
+#include <time.h>
+#include <stdio.h>
+#include <getopt.h>
+
+using namespace std;
+using namespace vcflib;
+
+void printVersion(void){
+	    cerr << "INFO: version 1.1.0 ; date: April 2014 ; author: Zev Kronenberg; email : zev.kronenberg@utah.edu " << endl;
+	    exit(1);
+}
+
+void printHelp(void){
+  cerr << endl << endl;
+  cerr << "INFO: help" << endl;
+  cerr << "INFO: description:" << endl;
+  cerr << "     ehh reports the decay of haplotype homozygosity around a single SNP.  Only the flanking window is read, through the tabix    " << endl;
+  cerr << "     index, so the file must be bgzipped and indexed.  Distances are in SNPs unless a genetic map (--map) or --physical is given. " << endl << endl;
+
+  cerr << "Output : ehh lines, one per site out from the core on each side until EHH reaches zero: " << endl;
+  cerr << "     1. ehh                                          " << endl;
+  cerr << "     2. seqid                                        " << endl;
+  cerr << "     3. side (-1 before the core, 1 after it)        " << endl;
+  cerr << "     4. position                                     " << endl;
+  cerr << "     5. distance from the core                       " << endl;
+  cerr << "     6. EHH target alternate                         " << endl;
+  cerr << "     7. EHH target reference                         " << endl;
+  cerr << "     8. EHH background alternate (NA without --background) " << endl;
+  cerr << "     9. EHH background reference (NA without --background) " << endl << endl;
+
+  cerr << "Output : bifurcation lines, one per haplotype group where the haplotypes carrying a core allele split: " << endl;
+  cerr << "     1. bifurcation                                  " << endl;
+  cerr << "     2. seqid                                        " << endl;
+  cerr << "     3. population (target or background)            " << endl;
+  cerr << "     4. core allele (0 reference, 1 alternate)       " << endl;
+  cerr << "     5. side (-1 before the core, 1 after it)        " << endl;
+  cerr << "     6. position of the split (the core for the root) " << endl;
+  cerr << "     7. parent group (-1 for the root)               " << endl;
+  cerr << "     8. group                                        " << endl;
+  cerr << "     9. haplotypes in the group                      " << endl << endl;
+
+  cerr << "INFO: ehh  --site chr1:1234567 --target 0,1,2,3,4,5,6,7 --background 11,12,13,16,17,19,22 --file my.phased.vcf.gz --type PL " << endl;
+  cerr << endl;
+
+  cerr << "INFO: required: s,site       -- argument: the core SNP, \"seqid:position\"                                                             " << endl;
+  cerr << "INFO: required: t,target     -- argument: a zero based comma separated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
+  cerr << "INFO: optional: b,background -- argument: a zero based comma separated list of background individuals corrisponding to VCF columns    " << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
+  cerr << "INFO: required: f,file       -- argument: a bgzipped, tabix indexed and phased VCF file                                              " << endl;
+  cerr << "INFO: required: y,type       -- argument: type of genotype likelihood: PL, GL or GP                                                   " << endl;
+  cerr << "INFO: optional: F,flank      -- argument: base pairs read either side of the core [200000]                                            " << endl;
+  cerr << "INFO: optional: P,phase      -- flag    : phase the genotypes (or likelihoods) in the window with a Li and Stephens HMM            " << endl;
+  cerr << "INFO: optional: K,states     -- argument: copying states per individual for --phase [16]                                              " << endl;
+  cerr << "INFO: optional: m,map        -- argument: genetic map, one \"seqid position cM\" per line; distances in cM                             " << endl;
+  cerr << "INFO: optional: p,physical   -- flag    : distances in base pairs rather than SNPs                                                     " << endl;
+  cerr << endl;
+
+  printVersion();
+
+  exit(1);
+}
+
+void loadIndices(map<int, int> & index, string set){
+
+  vector<string>  indviduals = split(set, ",");
+  vector<string>::iterator it = indviduals.begin();
+
+  for(; it != indviduals.end(); it++){
+    index[ atoi( (*it).c_str() ) ] = 1;
+  }
+}
+
+void loadPhased(haplotypeMatrix & haplotypes, genotype * pop){
+
+  // missing calls carry the reference allele
+
+  haplotypes.addSite();
+
+  int indIndex = 0;
+
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    if(gtFirst(*ind)){
+      haplotypes.setAlt(2*indIndex);
+    }
+    if(gtSecond(*ind)){
+      haplotypes.setAlt(2*indIndex + 1);
+    }
+    indIndex += 1;
+  }
+}
+
+// phases the buffered window and fills the haplotypes from the copying model
+
+void loadPhaser(haplotypeMatrix & haplotypes, lsPhaser & phaser){
+
+  phaser.phase();
+
+  for(int site = 0; site < phaser.nsites(); site++){
+    haplotypes.addSite();
+    for(int h = 0; h < phaser.nhaplotypes(); h++){
+      if(phaser.allele(h, site)){
+	haplotypes.setAlt(h);
+      }
+    }
+  }
+  phaser.clear();
+}
+
+// EHH of both core alleles in the target and the background, a line per
+// site out to one side until every one of them has reached zero.
+
+void decayCurve(haplotypeMatrix & haplotypes, vector<long int> & pos, vector<double> & coordinates,
+		vector<int> & target, vector<int> & background, int core, int side, string seqid){
+
+  ehhPartition targetAlt, targetRef, backgroundAlt, backgroundRef;
+
+  targetAlt.start(haplotypes,     target,     core, 1);
+  targetRef.start(haplotypes,     target,     core, 0);
+  backgroundAlt.start(haplotypes, background, core, 1);
+  backgroundRef.start(haplotypes, background, core, 0);
+
+  for(int site = core; site >= 0 && site < haplotypes.nsites; site += side){
+
+    if(site != core){
+      targetAlt.extend(haplotypes,     site);
+      targetRef.extend(haplotypes,     site);
+      backgroundAlt.extend(haplotypes, site);
+      backgroundRef.extend(haplotypes, site);
+    }
+
+    cout << "ehh\t" << seqid << "\t" << side << "\t" << pos[site] << "\t" << coordinates[site] - coordinates[core]
+	 << "\t" << targetAlt.ehh() << "\t" << targetRef.ehh();
+
+    if(background.empty()){
+      cout << "\tNA\tNA" << endl;
+    }
+    else{
+      cout << "\t" << backgroundAlt.ehh() << "\t" << backgroundRef.ehh() << endl;
+    }
+
+    if(targetAlt.exhausted() && targetRef.exhausted()
+       && backgroundAlt.exhausted() && backgroundRef.exhausted()){
+      break;
+    }
+  }
+}
+
+// The haplotypes carrying allele at the core start as one group, which
+// splits wherever its members differ moving out from the core.  Each split
+// is reported with its parent, so the lines form the bifurcation tree;
+// groups of one cannot split again and are not followed further.
+
+void bifurcation(haplotypeMatrix & haplotypes, vector<long int> & pos, vector<int> & haps,
+		 int core, int allele, int side, string population, string seqid){
+
+  vector< vector<int> > groups(1);
+  vector<int>           ids(1, 0);
+
+  for(vector<int>::iterator h = haps.begin(); h != haps.end(); h++){
+    if(haplotypes.allele(*h, core) == allele){
+      groups[0].push_back(*h);
+    }
+  }
+  if(groups[0].empty()){
+    return;
+  }
+
+  cout << "bifurcation\t" << seqid << "\t" << population << "\t" << allele << "\t" << side
+       << "\t" << pos[core] << "\t" << -1 << "\t" << 0 << "\t" << groups[0].size() << endl;
+
+  int nextId = 1;
+
+  for(int site = core + side; site >= 0 && site < haplotypes.nsites; site += side){
+
+    vector< vector<int> > split;
+    vector<int>           splitIds;
+
+    for(unsigned int g = 0; g < groups.size(); g++){
+
+      vector<int> child[2];
+
+      for(vector<int>::iterator h = groups[g].begin(); h != groups[g].end(); h++){
+	child[haplotypes.allele(*h, site)].push_back(*h);
+      }
+
+      if(child[0].empty() || child[1].empty()){
+	if(groups[g].size() > 1){
+	  split.push_back(groups[g]);
+	  splitIds.push_back(ids[g]);
+	}
+	continue;
+      }
+
+      for(int c = 0; c < 2; c++){
+	cout << "bifurcation\t" << seqid << "\t" << population << "\t" << allele << "\t" << side
+	     << "\t" << pos[site] << "\t" << ids[g] << "\t" << nextId << "\t" << child[c].size() << endl;
+	if(child[c].size() > 1){
+	  split.push_back(child[c]);
+	  splitIds.push_back(nextId);
+	}
+	nextId += 1;
+      }
+    }
+
+    groups.swap(split);
+    ids.swap(splitIds);
+
+    if(groups.empty()){
+      break;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+
+  // set the random seed for MCMC
+
+  srand((unsigned)time(NULL));
+
+  // the filename
+
+  string filename = "NA";
+
+  // the core SNP and the window read around it
+
+  string site = "NA";
+
+  long int flank = 200000;
+
+  // using vcflib; thanks to Erik Garrison
+
+  VariantCallFile variantFile;
+
+  // zero based index for the target and background indivudals
+
+  map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
+
+  // phase the genotypes with the copying model rather than require phased input
+
+  int phase  = 0;
+  int states = PHASE_STATES;
+
+  // distances in cM from a genetic map, in bp, or in SNPs
+
+  geneticMap gmap;
+
+  int physical = 0;
+
+  string type = "NA";
+
+    const struct option longopts[] =
+      {
+	{"version"   , 0, 0, 'v'},
+	{"help"      , 0, 0, 'h'},
+        {"file"      , 1, 0, 'f'},
+	{"site"      , 1, 0, 's'},
+	{"flank"     , 1, 0, 'F'},
+	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
+	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
+	{"type"      , 1, 0, 'y'},
+	{"phase"     , 0, 0, 'P'},
+	{"states"    , 1, 0, 'K'},
+	{"map"       , 1, 0, 'm'},
+	{"physical"  , 0, 0, 'p'},
+
+	{0,0,0,0}
+      };
+
+    int findex;
+    int iarg=0;
+
+    while(iarg != -1)
+      {
+	iarg = getopt_long(argc, argv, "y:s:F:t:b:f:hvT:B:PK:m:p", longopts, &findex);
+
+	switch (iarg)
+	  {
+	  case 'h':
+	    printHelp();
+	  case 'v':
+	    printVersion();
+	  case 'y':
+	    type = optarg;
+	    break;
+	  case 's':
+	    site = optarg;
+	    cerr << "INFO: core site: " << site << endl;
+	    break;
+	  case 'F':
+	    flank = atol(optarg);
+	    cerr << "INFO: flanking window: " << flank << endl;
+	    break;
+	  case 'P':
+	    phase = 1;
+	    cerr << "INFO: phasing genotypes with the Li and Stephens model" << endl;
+	    break;
+	  case 'K':
+	    states = atoi(optarg);
+	    cerr << "INFO: copying states per individual: " << states << endl;
+	    break;
+	  case 'm':
+	    gmap.load(optarg);
+	    cerr << "INFO: genetic map: " << optarg << endl;
+	    break;
+	  case 'p':
+	    physical = 1;
+	    cerr << "INFO: distances in base pairs" << endl;
+	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
+	  case 't':
+	    loadIndices(it, optarg);
+	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
+	    cerr << "INFO: target ids: " << optarg << endl;
+	    break;
+	  case 'b':
+	    loadIndices(ib, optarg);
+	    cerr << "INFO: there are " << ib.size() << " individuals in the background" << endl;
+	    cerr << "INFO: background ids: " << optarg << endl;
+	    break;
+	  case 'f':
+	    cerr << "INFO: file: " << optarg  <<  endl;
+	    filename = optarg;
+	    break;
+	  default:
+	    break;
+	  }
+      }
+
+    map<string, int> okayGenotypeLikelihoods;
+    okayGenotypeLikelihoods["PL"] = 1;
+    okayGenotypeLikelihoods["GL"] = 1;
+    okayGenotypeLikelihoods["GP"] = 1;
+    okayGenotypeLikelihoods["GT"] = 1;
+
+    if(type == "NA"){
+      cerr << "FATAL: failed to specify genotype likelihood format : PL or GL" << endl;
+      printHelp();
+      return 1;
+    }
+    if(okayGenotypeLikelihoods.find(type) == okayGenotypeLikelihoods.end()){
+      cerr << "FATAL: genotype likelihood is incorrectly formatted, only use: PL or GL" << endl;
+      printHelp();
+      return 1;
+    }
+
+    int format = formatType(type);
+
+    if(filename == "NA"){
+      cerr << "FATAL: did not specify a file" << endl;
+      printHelp();
+      return(1);
+    }
+
+    vector<string> siteFields = split(site, ":");
+
+    if(siteFields.size() != 2){
+      cerr << "FATAL: the site must be given as seqid:position" << endl;
+      printHelp();
+      return(1);
+    }
+
+    string   seqid    = siteFields[0];
+    long int position = atol(siteFields[1].c_str());
+
+    long int windowStart = position - flank > 1 ? position - flank : 1;
+
+    stringstream window;
+    window << seqid << ":" << windowStart << "-" << position + flank;
+
+    variantFile.open(filename);
+
+    if (!variantFile.is_open()) {
+        return 1;
+    }
+
+    if(! variantFile.setRegion(window.str())){
+      cerr <<"FATAL: unable to set region" << endl;
+      return 1;
+    }
+    cerr << "INFO: reading window: " << window.str() << endl;
+
+    Variant var(variantFile);
+
+    vector<string> samples = variantFile.sampleNames;
+    int nsamples = samples.size();
+
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, ib, backgroundNames, "background");
+
+    vector<int> target_h, background_h;
+
+    int index = 0, indexi = 0;
+
+    for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
+
+      if(targetMember[index]){
+	target_h.push_back(indexi);
+	indexi++;
+      }
+      if(backgroundMember[index]){
+	background_h.push_back(indexi);
+	indexi++;
+      }
+      index++;
+    }
+
+    if(target_h.size() < 2){
+      cerr << "FATAL: target option is required -- or -- less than two individuals in target\n";
+      printHelp();
+      return(1);
+    }
+
+    vector<long int> positions;
+
+    haplotypeMatrix haplotypes;
+    haplotypes.setHaplotypes(2 * indexi);
+
+    vector<int> targetHaps, backgroundHaps;
+
+    for(unsigned int i = 0; i < target_h.size(); i++){
+      targetHaps.push_back(2 * target_h[i]);
+      targetHaps.push_back(2 * target_h[i] + 1);
+    }
+    for(unsigned int i = 0; i < background_h.size(); i++){
+      backgroundHaps.push_back(2 * background_h[i]);
+      backgroundHaps.push_back(2 * background_h[i] + 1);
+    }
+
+    vector< map< string, vector<string> > * > total;
+
+    genotype * populationTotal = newGenotype(format);
+
+    lsPhaser phaser(format);
+    phaser.setStates(states);
+
+    int core = -1;
+
+    while (variantFile.getNextVariant(var)) {
+
+      if(!phase && !var.isPhased()){
+	cerr <<"FATAL: Found an unphased variant. All genotypes must be phased!" << endl;
+	printHelp();
+	return(1);
+      }
+
+      if(var.alt.size() > 1){
+	continue;
+      }
+
+      total.clear();
+
+      for(int nsamp = 0; nsamp < nsamples; nsamp++){
+
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
+
+	if(targetMember[nsamp]){
+	  total.push_back(&sample);
+	}
+	if(backgroundMember[nsamp]){
+	  total.push_back(&sample);
+	}
+      }
+
+      populationTotal->reset();
+      populationTotal->loadPop(total, var.sequenceName, var.position);
+
+      if(var.position == position){
+	core = positions.size();
+      }
+      positions.push_back(var.position);
+
+      if(phase){
+	phaser.addSite(populationTotal);
+      }
+      else{
+	loadPhased(haplotypes, populationTotal);
+      }
+    }
+
+    delete populationTotal;
+
+    if(core == -1){
+      cerr << "FATAL: " << site << " is not a biallelic site in the file" << endl;
+      return 1;
+    }
+
+    if(phase){
+      loadPhaser(haplotypes, phaser);
+    }
+
+    vector<double> coordinates;
+    siteCoordinates(gmap, physical, seqid, positions, coordinates);
+
+    for(int side = -1; side <= 1; side += 2){
+      decayCurve(haplotypes, positions, coordinates, targetHaps, backgroundHaps, core, side, seqid);
+    }
+    for(int side = -1; side <= 1; side += 2){
+      for(int allele = 1; allele >= 0; allele--){
+	bifurcation(haplotypes, positions, targetHaps, core, allele, side, "target", seqid);
+	bifurcation(haplotypes, positions, backgroundHaps, core, allele, side, "background", seqid);
+      }
+    }
+
+    return 0;
+}
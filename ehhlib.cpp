@@ -0,0 +1,397 @@
+#include "ehhlib.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdlib.h>
+
+static inline double pairCount(int n){
+  return 0.5 * n * (n - 1);
+}
+
+haplotypeMatrix::haplotypeMatrix(void){
+  setHaplotypes(0);
+}
+
+void haplotypeMatrix::setHaplotypes(int n){
+  nhaps  = n;
+  nwords = (n + 63) / 64;
+  clear();
+}
+
+void haplotypeMatrix::clear(void){
+  nsites = 0;
+  bits.clear();
+}
+
+void haplotypeMatrix::addSite(void){
+  bits.resize(bits.size() + nwords, 0);
+  nsites += 1;
+}
+
+ehhPartition::ehhPartition(void){
+  n     = 0;
+  pairs = 0;
+  total = 0;
+}
+
+void ehhPartition::start(const haplotypeMatrix & m, const vector<int> & haps, int core, int allele){
+
+  order.clear();
+  bounds.clear();
+
+  for(vector<int>::const_iterator h = haps.begin(); h != haps.end(); h++){
+    if(allele == -1 || m.allele(*h, core) == allele){
+      order.push_back(*h);
+    }
+  }
+
+  n     = order.size();
+  total = pairCount(n);
+  pairs = total;
+
+  if(n < 2){
+    order.clear();
+    return;
+  }
+  bounds.push_back(0);
+  bounds.push_back(n);
+
+  if(allele == -1){
+    extend(m, core);
+  }
+}
+
+void ehhPartition::extend(const haplotypeMatrix & m, int site){
+
+  if(order.empty()){
+    return;
+  }
+
+  const unsigned long long * row = m.row(site);
+
+  scratch.resize(order.size());
+  scratchBounds.clear();
+
+  int out = 0;
+
+  for(unsigned int g = 0; g + 1 < bounds.size(); g++){
+
+    int b = bounds[g];
+    int e = bounds[g + 1];
+
+    int n1 = 0;
+    for(int i = b; i < e; i++){
+      n1 += (row[order[i] >> 6] >> (order[i] & 63)) & 1;
+    }
+    int n0 = (e - b) - n1;
+
+    pairs += pairCount(n0) + pairCount(n1) - pairCount(e - b);
+
+    if(n0 < 2 && n1 < 2){
+      continue;
+    }
+
+    // stable split: the reference group first, then the alternate
+
+    int zero = out;
+    int one  = out + (n0 >= 2 ? n0 : 0);
+
+    for(int i = b; i < e; i++){
+      int h = order[i];
+      if((row[h >> 6] >> (h & 63)) & 1){
+	if(n1 >= 2){
+	  scratch[one++] = h;
+	}
+      }
+      else if(n0 >= 2){
+	scratch[zero++] = h;
+      }
+    }
+    if(n0 >= 2){
+      scratchBounds.push_back(out);
+      out += n0;
+    }
+    if(n1 >= 2){
+      scratchBounds.push_back(out);
+      out += n1;
+    }
+  }
+
+  scratch.resize(out);
+  order.swap(scratch);
+
+  if(out == 0){
+    bounds.clear();
+    return;
+  }
+  scratchBounds.push_back(out);
+  bounds.swap(scratchBounds);
+}
+
+ehhScan::ehhScan(void){
+  m         = NULL;
+  direction = 1;
+  k         = -1;
+  site      = -1;
+  n         = 0;
+  nref      = 0;
+  npop      = 1;
+}
+
+void ehhScan::start(const haplotypeMatrix & matrix, const vector<int> & haps, int dir){
+  start(matrix, haps, vector<int>(haps.size(), 0), dir);
+}
+
+void ehhScan::start(const haplotypeMatrix & matrix, const vector<int> & haps, const vector<int> & populations, int dir){
+  m         = &matrix;
+  direction = dir;
+  k         = -1;
+  site      = -1;
+  n         = haps.size();
+  nref      = 0;
+  npop      = 1;
+
+  label.assign(matrix.nhaps, -1);
+
+  for(int i = 0; i < n; i++){
+    label[haps[i]] = populations[i];
+    if(populations[i] >= npop){
+      npop = populations[i] + 1;
+    }
+  }
+
+  order      = haps;
+  divergence.assign(n, 0);
+  scratch.resize(n);
+  scratchDivergence.resize(n);
+
+  events.resize(2 * npop);
+  cursor.resize(2 * npop);
+  matching.resize(2 * npop);
+  counts.resize(2 * npop);
+}
+
+bool ehhScan::next(void){
+
+  k += 1;
+
+  if(k >= m->nsites){
+    return false;
+  }
+  site = direction > 0 ? k : m->nsites - 1 - k;
+
+  const unsigned long long * row = m->row(site);
+
+  // stable split on the allele at the new site: reference first, then
+  // alternate (Durbin 2014, algorithm 2)
+
+  int p = k + 1;
+  int q = k + 1;
+  int u = 0;
+  int v = 0;
+
+  for(int i = 0; i < n; i++){
+    int h = order[i];
+    if(divergence[i] > p){
+      p = divergence[i];
+    }
+    if(divergence[i] > q){
+      q = divergence[i];
+    }
+    if((row[h >> 6] >> (h & 63)) & 1){
+      scratch[v]           = h;
+      scratchDivergence[v] = q;
+      v += 1;
+      q  = 0;
+    }
+    else{
+      order[u]      = h;
+      divergence[u] = p;
+      u += 1;
+      p  = 0;
+    }
+  }
+
+  for(int i = 0; i < v; i++){
+    order[u + i]      = scratch[i];
+    divergence[u + i] = scratchDivergence[i];
+  }
+  nref = u;
+
+  return true;
+}
+
+// Every pair in the block is charged to the boundary holding the shortest
+// shared run between them (the rightmost one on ties), found with a stack
+// of boundaries whose shared runs increase.  The pairs of one population
+// charged to a boundary are its haplotypes on the left of it times those
+// on the right, read from running counts.
+
+void ehhScan::decayBlock(int allele, int b, int e){
+
+  for(int p = 0; p < npop; p++){
+    int c = allele * npop + p;
+    events[c].clear();
+    cursor[c]   = 0;
+    counts[c]   = prefix[e * npop + p] - prefix[b * npop + p];
+    matching[c] = pairCount(counts[c]);
+  }
+
+  stack.clear();
+
+  for(int i = b + 1; i <= e; i++){
+
+    // sites shared through the core; the block end acts as a boundary
+    // shorter than all of them
+
+    int shared = i < e ? k - divergence[i] + 1 : -1;
+
+    while(!stack.empty() && k - divergence[stack.back()] + 1 >= shared){
+      int t = stack.back();
+      stack.pop_back();
+      for(int p = 0; p < npop; p++){
+	int left  = prefix[t * npop + p] - prefix[previous[t] * npop + p];
+	int right = prefix[i * npop + p] - prefix[t * npop + p];
+	if(left > 0 && right > 0){
+	  events[allele * npop + p].push_back(make_pair(k - divergence[t] + 1, double(left) * right));
+	}
+      }
+    }
+    if(i < e){
+      previous[i] = stack.empty() ? b : stack.back();
+      stack.push_back(i);
+    }
+  }
+  for(int p = 0; p < npop; p++){
+    sort(events[allele * npop + p].begin(), events[allele * npop + p].end());
+  }
+}
+
+void ehhScan::decay(void){
+
+  prefix.assign((n + 1) * npop, 0);
+  previous.resize(n);
+
+  for(int i = 0; i < n; i++){
+    for(int p = 0; p < npop; p++){
+      prefix[(i + 1) * npop + p] = prefix[i * npop + p];
+    }
+    prefix[(i + 1) * npop + label[order[i]]] += 1;
+  }
+
+  decayBlock(0, 0, nref);
+  decayBlock(1, nref, n);
+}
+
+double ehhScan::pairs(int population, int allele, int steps){
+
+  int c = allele * npop + population;
+
+  vector< pair<int, double> > & ev = events[c];
+
+  // a pair sharing s sites through the core matches for s - 1 steps
+
+  while(cursor[c] < ev.size() && ev[cursor[c]].first <= steps){
+    matching[c] -= ev[cursor[c]].second;
+    cursor[c]   += 1;
+  }
+  return matching[c];
+}
+
+double ehhScan::ehh(int population, int allele, int steps){
+  double total = pairCount(count(population, allele));
+  return total > 0 ? pairs(population, allele, steps) / total : 0;
+}
+
+void geneticMap::load(string filename){
+
+  ifstream mapFile(filename.c_str());
+
+  if(!mapFile.is_open()){
+    cerr << "FATAL: could not open genetic map: " << filename << endl;
+    exit(1);
+  }
+
+  string line;
+
+  while(getline(mapFile, line)){
+
+    istringstream fields(line);
+    vector<string> field;
+    string f;
+    while(fields >> f){
+      field.push_back(f);
+    }
+    if(field.size() < 3){
+      continue;
+    }
+
+    char * endp;
+    long int position = strtol(field[1].c_str(), &endp, 10);
+    if(*endp != '\0'){
+      continue;
+    }
+    points[field[0]].push_back(make_pair(position, atof(field.back().c_str())));
+  }
+
+  for(map<string, vector< pair<long int, double> > >::iterator it = points.begin(); it != points.end(); it++){
+    sort(it->second.begin(), it->second.end());
+  }
+}
+
+bool geneticMap::empty(void){
+  return points.empty();
+}
+
+void geneticMap::interpolate(string seqid, vector<long int> & positions, vector<double> & cm){
+
+  map<string, vector< pair<long int, double> > >::iterator found = points.find(seqid);
+
+  if(found == points.end()){
+    cerr << "FATAL: the genetic map has no positions for seqid: " << seqid << endl;
+    exit(1);
+  }
+
+  vector< pair<long int, double> > & pts = found->second;
+
+  int n = pts.size();
+  int j = 0;
+
+  cm.resize(positions.size());
+
+  for(unsigned int i = 0; i < positions.size(); i++){
+
+    long int p = positions[i];
+
+    while(j + 1 < n && pts[j + 1].first <= p){
+      j++;
+    }
+    if(p <= pts[0].first){
+      cm[i] = pts[0].second;
+    }
+    else if(j == n - 1){
+      cm[i] = pts[n - 1].second;
+    }
+    else{
+      double f = double(p - pts[j].first) / (pts[j + 1].first - pts[j].first);
+      cm[i] = pts[j].second + f * (pts[j + 1].second - pts[j].second);
+    }
+  }
+}
+
+void siteCoordinates(geneticMap & gmap, bool physical, string seqid,
+                     vector<long int> & positions, vector<double> & coordinates){
+
+  if(!gmap.empty()){
+    gmap.interpolate(seqid, positions, coordinates);
+    return;
+  }
+
+  coordinates.resize(positions.size());
+
+  for(unsigned int i = 0; i < positions.size(); i++){
+    coordinates[i] = physical ? positions[i] : i;
+  }
+}
@@ -0,0 +1,222 @@
+// extended haplotype homozygosity on bit packed haplotypes
+
+#ifndef __EHHLIB_H
+#define __EHHLIB_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// One row of words per site with one bit per haplotype (set for the
+// alternate allele), so a contig of n haplotypes costs n/8 bytes a site.
+
+class haplotypeMatrix{
+public:
+
+  int nhaps;
+  int nsites;
+  int nwords;
+
+  haplotypeMatrix(void);
+
+  // sets the number of haplotypes and drops every site
+
+  void setHaplotypes(int n);
+  void clear(void);
+
+  // appends a site where every haplotype carries the reference allele
+
+  void addSite(void);
+
+  inline void setAlt(int hap){
+    bits[(nsites - 1) * nwords + (hap >> 6)] |= 1ULL << (hap & 63);
+  }
+
+  inline const unsigned long long * row(int site) const{
+    return &bits[site * nwords];
+  }
+
+  inline int allele(int hap, int site) const{
+    return (bits[site * nwords + (hap >> 6)] >> (hap & 63)) & 1;
+  }
+
+private:
+  vector<unsigned long long> bits;
+};
+
+// EHH by partition refinement.  The haplotypes that agree at every site
+// added so far form one group; adding a site splits each group by its
+// allele there and updates the count of identical pairs.  Groups of one
+// can never add a pair again so they are dropped, and the work per site
+// shrinks as homozygosity decays.
+
+class ehhPartition{
+public:
+
+  ehhPartition(void);
+
+  // starts from the haplotypes in haps that carry allele at the core site;
+  // an allele of -1 keeps them all, split by their core allele
+
+  void start(const haplotypeMatrix & m, const vector<int> & haps, int core, int allele);
+
+  void extend(const haplotypeMatrix & m, int site);
+
+  // identical pairs over all pairs; zero with fewer than two haplotypes
+
+  inline double ehh(void) const{
+    return total > 0 ? pairs / total : 0;
+  }
+
+  inline int size(void) const{
+    return n;
+  }
+
+  // true once every group is a singleton and EHH can only stay at zero
+
+  inline bool exhausted(void) const{
+    return order.empty();
+  }
+
+private:
+  int    n;
+  double pairs;
+  double total;
+
+  vector<int> order;
+  vector<int> bounds;
+  vector<int> scratch;
+  vector<int> scratchBounds;
+};
+
+// EHH to one side of every core in a single sweep, by the positional
+// prefix sort of Durbin (2014).  After each site the haplotypes are in the
+// order of their alleles read back from it towards the start of the
+// sweep, and each records how many sites it shares with the one before
+// it.  That encodes the nested partitions of every flanking segment
+// ending at the current core, so moving to the next core costs one pass
+// over the haplotypes rather than refining again from the core outwards.
+// A backward sweep gives the other side.
+
+class ehhScan{
+public:
+
+  ehhScan(void);
+
+  // sweeps m forwards (direction 1) or backwards (-1) over the haplotypes
+  // in haps; no site is current until the first next()
+
+  void start(const haplotypeMatrix & m, const vector<int> & haps, int direction);
+
+  // as above, pooling populations in one sweep: haps[i] belongs to
+  // population populations[i], numbered from zero, and pairs are counted
+  // within each population
+
+  void start(const haplotypeMatrix & m, const vector<int> & haps, const vector<int> & populations, int direction);
+
+  // moves on to the next site and returns false once past the last one
+
+  bool next(void);
+
+  inline int core(void) const{
+    return site;
+  }
+
+  // haplotypes carrying allele (0 or 1) at the core, over all populations
+
+  inline int count(int allele) const{
+    return allele ? n - nref : nref;
+  }
+
+  // sorts the points at which the EHH of each population and core allele
+  // decays; pairs() and ehh() then read the steps outward from the core in
+  // increasing order for each of them
+
+  void decay(void);
+
+  // haplotypes of population carrying allele at the core, after decay()
+
+  inline int count(int population, int allele) const{
+    return counts[allele * npop + population];
+  }
+
+  // identical pairs among the haplotypes of population carrying allele at
+  // the core, over the core and the steps sites beyond it
+
+  double pairs(int population, int allele, int steps);
+
+  // those pairs over all pairs; zero with fewer than two haplotypes
+
+  double ehh(int population, int allele, int steps);
+
+  inline double ehh(int allele, int steps){
+    return ehh(0, allele, steps);
+  }
+
+private:
+  const haplotypeMatrix * m;
+
+  int direction;
+  int k;
+  int site;
+  int n;
+  int nref;
+  int npop;
+
+  // population of each haplotype of the matrix, -1 if not swept
+
+  vector<int> label;
+
+  // order of the haplotypes and the sweep index where each one's match
+  // with its predecessor begins
+
+  vector<int> order;
+  vector<int> divergence;
+  vector<int> scratch;
+  vector<int> scratchDivergence;
+
+  // per allele and population: the step at which each group of pairs
+  // stops matching, and the pairs still matching
+
+  vector< vector< pair<int, double> > > events;
+  vector<unsigned int> cursor;
+  vector<double>       matching;
+  vector<int>          counts;
+
+  vector<int> stack;
+  vector<int> previous;
+  vector<int> prefix;
+
+  void decayBlock(int allele, int b, int e);
+};
+
+// A genetic map read from whitespace separated lines of seqid, position
+// (bp) and cumulative cM.  The cM is taken from the last column, so both
+// "seqid pos cM" and the HapMap "seqid pos rate cM" layouts load; lines
+// whose position is not a number are headers.
+
+class geneticMap{
+public:
+
+  void load(string filename);
+  bool empty(void);
+
+  // cM at each of the ascending positions: linear between the map points
+  // and held at the end values beyond them
+
+  void interpolate(string seqid, vector<long int> & positions, vector<double> & cm);
+
+private:
+  map<string, vector< pair<long int, double> > > points;
+};
+
+// The coordinates EHH is integrated over, one per site of a contig: cM
+// from the map when one is loaded, else bp with physical set, else the
+// SNP index.
+
+void siteCoordinates(geneticMap & gmap, bool physical, string seqid,
+                     vector<long int> & positions, vector<double> & coordinates);
+
+#endif
@@ -1,5 +1,7 @@
 #include "Variant.h"
 #include "split.h"
+#include "var.h"
+#include "ehhlib.h"
 #include "cdflib.h"
 #include "pdflib.h"
 
@@ -11,169 +13,21 @@
 #include <time.h>
 #include <stdio.h>
 #include <getopt.h>
+#include <algorithm>
+
+#ifdef HAS_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace vcflib;
 
-struct pop{
-  string   seqid;
-  long int pos;
-
-  double nalt ;
-  double nref ;
-  double af   ; 
-  double nhomr;
-  double nhoma;
-  double nhet ;
-  double ngeno;
-  double fis  ;
-
-  vector<int>    geno_index ;
-  vector< vector< double > > unphred_p;  
-  vector<string> genotypes;
-};
-
-double unphred(string phred){  
-  double unphred = atof(phred.c_str());
-  unphred = unphred / -10;
-  return unphred;
-}
-
-void initPop(pop & population){
-  population.nalt  = 0;
-  population.nref  = 0;
-  population.af    = 0;
-  population.nhomr = 0;
-  population.nhoma = 0;
-  population.nhet  = 0;
-  population.ngeno = 0;
-  population.fis   = 0;
-  
-}
-
-void loadPop( vector< map< string, vector<string> > >& group, pop & population, string seqid, long int pos, int phased){
+// what the phasing window keeps of each site
 
-  vector< map< string, vector<string> > >::iterator targ_it = group.begin();
-  
-  population.seqid = seqid;
-  population.pos   = pos  ;
-    
-  for(; targ_it != group.end(); targ_it++){
-    
-    string genotype = (*targ_it)["GT"].front();
-    
-    vector<double> phreds;
-    
-    double sum  = 0;
-    
-    if(phased == 0){
-
-      if(genotype != "./."){
-	
-	double pa  = exp( unphred((*targ_it)["PL"][0])) ; 
-	double pab = exp( unphred((*targ_it)["PL"][1])) ; 
-	double pbb = exp( unphred((*targ_it)["PL"][2])) ; 
-	
-	double norm = pa + pab + pbb  ;
-	
-	sum += (pa  / norm);
-	phreds.push_back(sum);
-	sum += (pab / norm);
-	phreds.push_back(sum);
-	sum += (pbb / norm);
-	phreds.push_back(sum);
-      }
-      else{
-	phreds.push_back(1/3);
-	phreds.push_back(2/3);
-	phreds.push_back(1);
-      }
-    }
-    
-    population.unphred_p.push_back(phreds);
-
-    population.genotypes.push_back(genotype);  
-
-    while(1){
-      if(genotype == "./."){
-      	population.geno_index.push_back(-1);
-	break;
-      }
-      if(genotype == "0/0"){
-	population.ngeno += 1;
-	population.nhomr += 1;
-	population.nref  += 2;
-	population.geno_index.push_back(0);
-	break;
-      }
-      if(genotype == "0/1"){
-	population.ngeno += 1;
-	population.nhet  += 1;
-	population.nref  += 1;
-	population.nalt  += 1;
-	population.geno_index.push_back(1);
-	break;
-      }
-      if(genotype == "1/1"){
-	population.ngeno += 1;
-	population.nhoma += 1;
-	population.nalt  += 2;
-	population.geno_index.push_back(2);
-	break;
-      }
-      if(genotype == "0|0"){
-	population.ngeno += 1;
-	population.nhomr += 1;
-	population.nref  += 2;
-	population.geno_index.push_back(0);
-	break;
-      }
-      if(genotype == "0|1"){
-	population.ngeno += 1;
-	population.nhet  += 1;
-	population.nref  += 1;
-	population.nalt  += 1;
-	population.geno_index.push_back(1);
-	break;
-      }
-      if(genotype == "1|0"){
-        population.ngeno += 1;
-        population.nhet  += 1;
-        population.nref  += 1;
-        population.nalt  += 1;
-        population.geno_index.push_back(1);
-        break;
-      }
-      if(genotype == "1|1"){
-	population.ngeno += 1;
-	population.nhoma += 1;
-	population.nalt  += 2;
-	population.geno_index.push_back(2);
-	break;
-      }
-      cerr << "FATAL: unknown genotype" << endl;
-      exit(1);
-    }
-  }
-
-  if(population.nalt == 0 && population.nref == 0){
-    population.af = -1;
-  }
-  else{
-   
-    population.af  = (population.nalt / (population.nref + population.nalt));
-
-    if(population.nhet > 0){
-      population.fis = ( 1 - ((population.nhet/population.ngeno) / (2*population.af*(1 - population.af))));
-    }
-    else{
-      population.fis = 1;
-    }
-    if(population.fis < 0){
-      population.fis = 0.00001;
-    }
-  }  
-}
+struct phaseSite{
+  vector<unsigned char> gtCodes;
+  vector<double>        cdf;
+};
 
 void loadIndices(map<int, int> & index, string set){
   
@@ -186,9 +40,16 @@ void loadIndices(map<int, int> & index, string set){
   }
 }
 
-void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<int> & target, vector<int> & background, string state, string seqid){
+// Haplotypes carrying the derived allele at the core are extended one site
+// either side per step, in the target and the background, until EHH in
+// either drops below 0.05.  The ancestral target haplotypes are extended
+// alongside for the iHS ratio.
+
+void calc(haplotypeMatrix & haplotypes, vector<long int> & pos, vector<int> & target, vector<int> & background, int derived, string seqid){
 
-  for(int snp = 0; snp < haplotypes[0][0].length(); snp++){
+  ehhPartition targetDerived, targetAncestral, backgroundDerived;
+
+  for(int snp = 0; snp < haplotypes.nsites; snp++){
     
     double ehhsat = 1;
     double ehhsab = 1;
@@ -202,6 +63,10 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<int> &
     int start = snp;
     int end   = snp;
 
+    targetDerived.start(haplotypes,     target,     snp, derived);
+    targetAncestral.start(haplotypes,   target,     snp, 1 - derived);
+    backgroundDerived.start(haplotypes, background, snp, derived);
+
     while( ehhAT > 0.05 && ehhAB > 0.05 ) {
      
       start -= 1;
@@ -210,55 +75,21 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<int> &
       if(start == -1){
 	break;
       }
-      if(end == haplotypes[0][0].length() - 1){
+      if(end == haplotypes.nsites){
 	break;
       }
-      
-      map<string , int> targetH, backgroundH;
-
-      double sumrT = 0;
-      double sumaT = 0;
-      double sumrB = 0;
-      double sumaB = 0;
-      double nrefT = 0;
-      double naltT = 0;
-      double nrefB = 0;
-      double naltB = 0;
-
-      for(int i = 0; i < target.size(); i++){
-	targetH[ haplotypes[target[i]][0].substr(start, (end - start)) ]++;
-	targetH[ haplotypes[target[i]][1].substr(start, (end - start)) ]++;
-      }
-      for(int i = 0; i < background.size(); i++){
-	backgroundH[ haplotypes[background[i]][0].substr(start, (end - start)) ]++;
-	backgroundH[ haplotypes[background[i]][0].substr(start, (end - start)) ]++;
-      }
 
-      for( map<string, int>::iterator th = targetH.begin(); th != targetH.end(); th++){    	
-	if( (*th).first.substr( (end - start)/2,1 ) == state){     
-	   sumaT += r8_choose(th->second, 2);  
-	   naltT += th->second;
-	}
-	else{
-	  sumrT += r8_choose(th->second, 2);  
-	  nrefT += th->second;
-	}
-      }
+      targetDerived.extend(haplotypes,     start);
+      targetDerived.extend(haplotypes,     end);
+      targetAncestral.extend(haplotypes,   start);
+      targetAncestral.extend(haplotypes,   end);
+      backgroundDerived.extend(haplotypes, start);
+      backgroundDerived.extend(haplotypes, end);
 
-      for( map<string, int>::iterator bh = backgroundH.begin(); bh != backgroundH.end(); bh++){
-        if( (*bh).first.substr( (end - start)/2,1 ) == state){
-	  sumaB += r8_choose(bh->second, 2);
-	  naltB += bh->second;
-        }
-        else{
-          sumrB += r8_choose(bh->second, 2);
-          nrefB += bh->second;
-        }
-      }
-      ehhAT = sumaT / (r8_choose(naltT, 2));
-      ehhAB = sumaB / (r8_choose(naltB, 2));
+      ehhAT = targetDerived.ehh();
+      ehhAB = backgroundDerived.ehh();
       
-      double ehhRT = sumrT / (r8_choose(nrefT, 2));
+      double ehhRT = targetAncestral.ehh();
 
       iHSR += ehhRT;
       iHSA += ehhAT;
@@ -271,148 +102,180 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<int> &
   }    
 }
 
-double EHH(string haplotypes[][2], int nhaps){
+// Local phasing works on packed haplotype words: bits 0-4 hold the last
+// five alleles already phased and bits 5-19 the alleles sampled for the
+// window, so a restart is a few integer operations per individual and its
+// EHH is found by sorting the words rather than counting strings in a map.
 
-  map<string , int> hapcounts;
+#define PHASE_RESTARTS 1000
+#define PHASE_CONTEXT  5
 
-  for(int i = 0; i < nhaps; i++){
-    hapcounts[ haplotypes[i][0] ]++;
-    hapcounts[ haplotypes[i][1] ]++;
-  }
+// splitmix64; every thread draws its restarts from its own stream
 
-  
-  double sum = 0;
-  double nh  = 0;
+struct phaseRng{
+  unsigned long long state;
+};
 
-  for( map<string, int>::iterator it = hapcounts.begin(); it != hapcounts.end(); it++){
-    nh  += it->second; 
-    sum += r8_choose(it->second, 2);
-  }
+inline double phaseUniform(phaseRng & rng){
+  unsigned long long z = (rng.state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
 
-  double max = (sum /  r8_choose(nh, 2));
-  
-  return max;
+double packedEHH(vector<unsigned int> & words, vector<unsigned int> & sorted){
 
-}
+  sorted = words;
+  sort(sorted.begin(), sorted.end());
 
+  double sum = 0;
+  double nh  = sorted.size();
 
-void printHaplotypes(string haps[][2], int ntargets){
-  for(int snp = 0; snp < haps[0][1].length(); snp++){
-    for(int ind = 0; ind < ntargets; ind++){
-      cout << haps[ind][0].substr(snp , 1) << "\t";
-      cout << haps[ind][1].substr(snp , 1) << "\t";
+  unsigned int i = 0;
+  while(i < sorted.size()){
+    unsigned int j = i + 1;
+    while(j < sorted.size() && sorted[j] == sorted[i]){
+      j++;
     }
-    cout << endl;
+    sum += r8_choose(j - i, 2);
+    i = j;
   }
+  return (sum /  r8_choose(nh, 2));
 }
 
-void loadImprovement(string tmpHaplotypes[][2], string haplotypes[][2], int ntarget){
-
-  for(int i= 0; i < ntarget; i++){
-    haplotypes[i][0] = tmpHaplotypes[i][0];
-    haplotypes[i][1] = tmpHaplotypes[i][1];
+void printHaplotypes(haplotypeMatrix & haps){
+  for(int snp = 0; snp < haps.nsites; snp++){
+    for(int hap = 0; hap < haps.nhaps; hap++){
+      cout << haps.allele(hap, snp) << "\t";
+    }
+    cout << endl;
   }
-
 }
 
-void appendHaplotypes(string tmpHaplotypes[][2], string haplotypes[][2], int ntarget){ 
-  for(int i= 0; i < ntarget; i++){
-    haplotypes[i][0].append(tmpHaplotypes[i][0].substr(5,15));
-    haplotypes[i][1].append(tmpHaplotypes[i][1].substr(5,15));
-  }
-}
+// phased input; missing calls carry the reference allele
 
-void loadPhased(string haplotypes[][2], list<pop> & window, int ntarget){
-  for(list<pop>::iterator pos = window.begin(); pos != window.end(); pos++){
-    int indIndex = 0;
-    for(vector<int>::iterator ind = pos->geno_index.begin(); ind != pos->geno_index.end(); ind++){
-      string g = pos->genotypes[indIndex];
-      vector< string > gs = split(g, "|");
-      haplotypes[indIndex][0].append(gs[0]);
-      haplotypes[indIndex][1].append(gs[1]);
-      indIndex++;
+void loadPhased(haplotypeMatrix & haplotypes, list<phaseSite> & window, int ntarget){
+  for(list<phaseSite>::iterator pos = window.begin(); pos != window.end(); pos++){
+    haplotypes.addSite();
+    for(int ind = 0; ind < ntarget; ind++){
+      if(gtFirst(pos->gtCodes[ind])){
+	haplotypes.setAlt(2*ind);
+      }
+      if(gtSecond(pos->gtCodes[ind])){
+	haplotypes.setAlt(2*ind + 1);
+      }
     }
   }
 }
 
-void localPhase(string haplotypes[][2], list<pop> & window, int ntarget){
- 
-  double ehhmax = -1;
-  
-  string totalHaplotypes[ntarget][2];
-  
-  for(int k = 0; k < 1000; k++){
-    
-    string tempHaplotypes[ntarget][2] ;
-    
-    int tlength = haplotypes[0][0].size();
-    
-    for(int nt = 0; nt < ntarget ; nt++){
-      if(tlength > 0 ){
-   	tempHaplotypes[nt][0] = haplotypes[nt][0].substr(tlength - 5, 5);
-   	tempHaplotypes[nt][1] = haplotypes[nt][1].substr(tlength - 5, 5);
-      }
-      else{
-   	tempHaplotypes[nt][0] = "00000";
-   	tempHaplotypes[nt][1] = "00000";
+void localPhase(haplotypeMatrix & haplotypes, list<phaseSite> & window, int ntarget){
+
+  int nsnp = window.size();
+
+  vector<phaseSite *> sites;
+  for(list<phaseSite>::iterator pos = window.begin(); pos != window.end(); pos++){
+    sites.push_back(&(*pos));
+  }
+
+  // the last alleles already phased anchor the new window
+
+  vector<unsigned int> context(2 * ntarget, 0);
+
+  int tlength = haplotypes.nsites;
+
+  if(tlength >= PHASE_CONTEXT){
+    for(int nt = 0; nt < ntarget; nt++){
+      for(int b = 0; b < PHASE_CONTEXT; b++){
+	context[2*nt    ] |= haplotypes.allele(2*nt,     tlength - PHASE_CONTEXT + b) << b;
+	context[2*nt + 1] |= haplotypes.allele(2*nt + 1, tlength - PHASE_CONTEXT + b) << b;
       }
     }
- 
-    int snpIndex  = 0;
+  }
 
-    for(list<pop>::iterator pos = window.begin(); pos != window.end(); pos++){    
-      
-      int indIndex = 0;
+  double               ehhmax = -1;
+  vector<unsigned int> best(context);
 
-      for(vector<int>::iterator ind = pos->geno_index.begin(); ind != pos->geno_index.end(); ind++){      
-	int g = pos->geno_index[indIndex];
-	double rang  = ((double)rand() / (double)(RAND_MAX));
-	if(rang < pos->unphred_p[indIndex][0]){
-	  g = 0;
-	}
-	else if(rang < pos->unphred_p[indIndex][1]){
-	  g = 1;
-	}
-	else{
-	  g = 2;
-	}	
-	if(g == 0 ){
-          tempHaplotypes[indIndex][0].append("0");
-          tempHaplotypes[indIndex][1].append("0");
-        }
-	if( g == 2 ){	
-	  tempHaplotypes[indIndex][0].append("1");
-	  tempHaplotypes[indIndex][1].append("1");
-	}
-	if(g == 1){
-	  double ranh  = ((double)rand() / (double)(RAND_MAX)); 
-	  if(ranh < 0.5){
-	    tempHaplotypes[indIndex][0].append("0");
-	    tempHaplotypes[indIndex][1].append("1");
+  unsigned long long seed = (unsigned long long)rand() << 32 | rand();
+
+#ifdef HAS_OPENMP
+#pragma omp parallel
+#endif
+  {
+    int thread = 0;
+#ifdef HAS_OPENMP
+    thread = omp_get_thread_num();
+#endif
+    phaseRng rng;
+    rng.state = seed + 0xD1B54A32D192ED03ULL * (thread + 1);
+
+    double               threadMax = -1;
+    vector<unsigned int> threadBest(context);
+    vector<unsigned int> words(2 * ntarget);
+    vector<unsigned int> sorted;
+
+#ifdef HAS_OPENMP
+#pragma omp for
+#endif
+    for(int k = 0; k < PHASE_RESTARTS; k++){
+
+      words = context;
+
+      for(int snp = 0; snp < nsnp; snp++){
+
+	unsigned int bit = PHASE_CONTEXT + snp;
+
+	for(int ind = 0; ind < ntarget; ind++){
+	  const double * cdf = &sites[snp]->cdf[3*ind];
+
+	  double rang = phaseUniform(rng);
+
+	  if(rang < cdf[0]){
+	    continue;
 	  }
-	  else{
-	    tempHaplotypes[indIndex][0].append("1");
-	    tempHaplotypes[indIndex][1].append("0");
+	  if(rang < cdf[1]){
+	    if(phaseUniform(rng) < 0.5){
+	      words[2*ind + 1] |= 1u << bit;
+	    }
+	    else{
+	      words[2*ind    ] |= 1u << bit;
+	    }
+	    continue;
 	  }
-	}	
-	indIndex++; 
+	  words[2*ind    ] |= 1u << bit;
+	  words[2*ind + 1] |= 1u << bit;
+	}
       }
-      snpIndex++; 
-    } 
 
+      double ehh = packedEHH(words, sorted);
+      if(ehh > threadMax){
+	threadMax  = ehh;
+	threadBest = words;
+      }
+    }
 
-    double ehh = EHH(tempHaplotypes, ntarget);    
-    if(ehh > ehhmax){
-      ehhmax = ehh;
-      loadImprovement(tempHaplotypes, totalHaplotypes, ntarget);
+#ifdef HAS_OPENMP
+#pragma omp critical
+#endif
+    {
+      if(threadMax > ehhmax){
+	ehhmax = threadMax;
+	best   = threadBest;
+      }
+    }
+  }
 
+  for(int snp = 0; snp < nsnp; snp++){
+    unsigned int bit = PHASE_CONTEXT + snp;
+    haplotypes.addSite();
+    for(int hap = 0; hap < 2 * ntarget; hap++){
+      if((best[hap] >> bit) & 1){
+	haplotypes.setAlt(hap);
+      }
     }
   }
-  appendHaplotypes(totalHaplotypes, haplotypes, ntarget);
 }
 
-  
-
 int main(int argc, char** argv) {
 
   // set the random seed for MCMC
@@ -434,6 +297,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -447,17 +314,24 @@ int main(int argc, char** argv) {
 
   int phased = 0;
 
+  // genotype likelihood format used for phasing
+
+  string type = "PL";
+
     const struct option longopts[] = 
       {
 	{"version"   , 0, 0, 'v'},
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"deltaaf"   , 1, 0, 'd'},
 	{"region"    , 1, 0, 'r'},
 	{"mutation"  , 1, 0, 'm'},
 	{"phased"    , 1, 0, 'p'},
+	{"type"      , 1, 0, 'y'},
 	{0,0,0,0}
       };
 
@@ -466,7 +340,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "p:m:r:d:t:b:f:hv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "p:m:r:d:t:b:f:hvT:B:y:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -490,10 +364,13 @@ int main(int argc, char** argv) {
 	    cerr << endl;
 	    cerr << "INFO: required: r,region     -- a genomice range to calculate gl-XPEHH on in the format : \"seqid:start-end]\" or \"seqid\" " << endl;
 	    cerr << "INFO: required: t,target     -- a zero base comma seperated list of target individuals corrisponding to VCF columns        " << endl;
+	    cerr << "INFO: optional: T,target-file -- a file of target sample names, one per line; adds to --target" << endl;
 	    cerr << "INFO: required: b,background -- a zero base comma seperated list of background individuals corrisponding to VCF columns    " << endl;
-	    cerr << "INFO: required: f,file a     -- proper formatted VCF.  the FORMAT field MUST contain \"PL\" if option phased == 0           " << endl; 
+	    cerr << "INFO: optional: B,background-file -- a file of background sample names, one per line; adds to --background" << endl;
+	    cerr << "INFO: required: f,file a     -- proper formatted VCF.  the FORMAT field MUST contain the --type field if phased == 0 " << endl; 
 	    cerr << "INFO: optional: m,mutation   -- which state is derived in vcf [0,1] default is 1                                            " << endl;
 	    cerr << "INFO: optional: p,phased     -- phasing flag [0,1] 0 = phase vcf, 1 = vcf is already phased                                 " << endl;
+	    cerr << "INFO: optional: y,type       -- genotype likelihood format used for phasing: PL, GL or GP; default is PL                    " << endl;
 	    cerr << endl; 
 	    cerr << "INFO: version 1.0.1 ; date: April 2014 ; author: Zev Kronenberg; email : zev.kronenberg@utah.edu " << endl;
 	    cerr << endl << endl;
@@ -506,10 +383,22 @@ int main(int argc, char** argv) {
 	    phased = atoi(optarg);
 	    cerr << "INFO: setting phase to: " << phased << endl;
 	    break;
+	  case 'y':
+	    type = optarg;
+	    cerr << "INFO: genotype likelihood format: " << type << endl;
+	    break;
 	  case 'm':
 	    mut = optarg;
 	    cerr << "INFO: derived state set to " << mut << endl;
 	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -540,6 +429,16 @@ int main(int argc, char** argv) {
       return(1);
     }
 
+    // phased input is read from GT alone
+
+    int format = phased ? FORMAT_GT : formatType(type);
+
+    if(format != FORMAT_GT && format != FORMAT_GL && format != FORMAT_GP && format != FORMAT_PL){
+      cerr << "FATAL: genotype likelihood is incorrectly formatted, only use: PL, GL or GP" << endl;
+      cerr << "INFO: please use gl-XPEHH --help" << endl;
+      return(1);
+    }
+
 
     variantFile.open(filename);
     
@@ -559,9 +458,13 @@ int main(int argc, char** argv) {
     Variant var(variantFile);
 
     vector<string> samples = variantFile.sampleNames;
+
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, ib, backgroundNames, "background");
+
     vector<int>    target_h, background_h;
 
-    int index, indexi = 0;
+    int index = 0, indexi = 0;
 
     cerr << "INFO: there are " << samples.size() << " individuals in the VCF" << endl;
 
@@ -573,11 +476,11 @@ int main(int argc, char** argv) {
 
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
      
-      if(it.find(index) != it.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
-      if(ib.find(index) != ib.end()){
+      if(backgroundMember[index]){
 	background_h.push_back(indexi);
 	indexi++;
       }
@@ -585,17 +488,44 @@ int main(int argc, char** argv) {
     }
     
 
-    list< pop > tdat, bdat, zdat;
+    // only the sites waiting to be phased are kept; the phased haplotypes
+    // are packed at one bit per haplotype
+
+    list< phaseSite > zdat;
 
     vector<long int> positions;
 
-    string haplotypes [it.size() + ib.size()][2];    
+    // one pair of haplotypes per target and background individual
+
+    int nhaps = indexi;
+
+    haplotypeMatrix haplotypes;
+    haplotypes.setHaplotypes(2 * nhaps);
+
+    vector<int> targetHaps, backgroundHaps;
+
+    for(unsigned int i = 0; i < target_h.size(); i++){
+      targetHaps.push_back(2 * target_h[i]);
+      targetHaps.push_back(2 * target_h[i] + 1);
+    }
+    for(unsigned int i = 0; i < background_h.size(); i++){
+      backgroundHaps.push_back(2 * background_h[i]);
+      backgroundHaps.push_back(2 * background_h[i] + 1);
+    }
     
     string seqid;
 
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * popt = newGenotype(format);
+    genotype * popb = newGenotype(format);
+    genotype * popz = newGenotype(format);
+
+    int nsamples = samples.size();
+
     while (variantFile.getNextVariant(var)) {
-        map<string, map<string, vector<string> > >::iterator s     = var.samples.begin(); 
-        map<string, map<string, vector<string> > >::iterator sEnd  = var.samples.end();
         
 	// biallelic sites naturally 
 
@@ -603,68 +533,65 @@ int main(int argc, char** argv) {
 	  continue;
 	}
 
-	vector < map< string, vector<string> > > target, background, total;
-	        
-	int sindex = 0;
+	target.clear();
+	background.clear();
+	total.clear();
 
-        for (; s != sEnd; s++) {	  
-	  
-	  map<string, vector<string> >& sample = s->second;
+	for(int nsamp = 0; nsamp < nsamples; nsamp++){
+
+	  map<string, vector<string> > & sample = var.samples[ samples[nsamp] ];
 	  
-	  if(it.find(sindex) != it.end() ){
-	    target.push_back(sample);
-	    total.push_back(sample);	
+	  if(targetMember[nsamp]){
+	    target.push_back(&sample);
+	    total.push_back(&sample);	
 	  }
-	  if(ib.find(sindex) != ib.end()){
-	    background.push_back(sample);
-	    total.push_back(sample);
+	  if(backgroundMember[nsamp]){
+	    background.push_back(&sample);
+	    total.push_back(&sample);
 	  }  
-	  sindex += 1;
 	}
 	
 	seqid = var.sequenceName;
 
-	pop popt, popb, popz;
+	popt->reset();
+	popb->reset();
+	popz->reset();
 
-	initPop(popt);
-	initPop(popb);
-	initPop(popz);
+	popt->loadPop(target,     var.sequenceName, var.position);
+	popb->loadPop(background, var.sequenceName, var.position);
+	popz->loadPop(total,      var.sequenceName, var.position);
 
-	loadPop(target,     popt, var.sequenceName, var.position, phased );
-	loadPop(background, popb, var.sequenceName, var.position, phased );
-	loadPop(total,      popz, var.sequenceName, var.position, phased );
-
-	if(popt.af == -1 || popb.af == -1){
+	if(popt->af == -1 || popb->af == -1){
 	  continue;
 	}
-	if(popz.af > 0.95 || popz.af < 0.05){
+	if(popz->af > 0.95 || popz->af < 0.05){
 	  continue;
 	}
-	if(popt.af == 0 && popb.af == 1){
+	if(popt->af == 0 && popb->af == 1){
 	  continue;
 	}
-	if(popt.af == 1 && popb.af == 0){
+	if(popt->af == 1 && popb->af == 0){
 	  continue;
 	}
 		
-	tdat.push_back(popt);
-	bdat.push_back(popb);
-	zdat.push_back(popz);
+	zdat.push_back(phaseSite());
+	zdat.back().gtCodes = popz->gtCodes;
+	zdat.back().cdf     = popz->genoLikelihoodsCDF;
        
 	positions.push_back(var.position);
 	
 	counts += 1;
 	if(counts >= 1000){
-	  cerr << "INFO: processed " << haplotypes[0][0].size() << " SNPs; current location : " << var.position << endl;
+	  cerr << "INFO: processed " << haplotypes.nsites << " SNPs; current location : " << var.position << endl;
 	  counts = 0;
 	}
 
 	while(zdat.size() >= 15 && !zdat.empty()){
           if(phased == 0){	    
-            localPhase(haplotypes, zdat, (it.size() + ib.size()));
+            localPhase(haplotypes, zdat, nhaps);
           }
           else{
-            loadPhased(haplotypes, zdat, (it.size() + ib.size()));
+            loadPhased(haplotypes, zdat, nhaps);
           }
           while(!zdat.empty()){
             zdat.pop_front();
@@ -673,10 +600,10 @@ int main(int argc, char** argv) {
     }
 
     if(phased == 0){
-      localPhase(haplotypes, zdat, (it.size() + ib.size()));
+      localPhase(haplotypes, zdat, nhaps);
     }
     else{
-      loadPhased(haplotypes, zdat, (it.size() + ib.size()));
+      loadPhased(haplotypes, zdat, nhaps);
     }
     while(!zdat.empty()){
       zdat.pop_front();
@@ -685,7 +612,11 @@ int main(int argc, char** argv) {
 
     cerr << "INFO: phasing done" << endl;
    
-    calc(haplotypes, (it.size() + ib.size()), positions, target_h, background_h,  mut, seqid);
+    calc(haplotypes, positions, targetHaps, backgroundHaps, atoi(mut.c_str()), seqid);
+
+    delete popt;
+    delete popb;
+    delete popz;
 
     cerr << "INFO: gl-XPEHH finished" << endl;
 
@@ -40,7 +40,9 @@ void printHelp(void){
   cerr << endl;
 
   cerr << "INFO: required: t,target     -- argument: a zero base comma seperated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: b,background -- argument: a zero base comma seperated list of background individuals corrisponding to VCF columns    " << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
   cerr << "INFO: required: f,file       -- argument: a properly formatted phased VCF file                                                       " << endl;
   cerr << "INFO: required: y,type       -- argument: type of genotype likelihood: PL, GL or GP                                                  " << endl;
   cerr << "INFO: optional: r,region     -- argument: a genomice range to calculate hapLrt on in the format : \"seqid:start-end\" or \"seqid\" " << endl;
@@ -292,17 +294,14 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<double
 }
 
 void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
+
+  // missing calls carry the reference allele
+
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-//    if((haplotypes[0][0].size() % 100) == 0){
-//      cerr << "string size:"  << haplotypes[0][0].size() << endl;
-//    }
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);  
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    haplotypes[indIndex][0] += char('0' + gtFirst(*ind));
+    haplotypes[indIndex][1] += char('0' + gtSecond(*ind));
     indIndex += 1;
   }
 }
@@ -328,6 +327,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> targetIndex, backgroundIndex;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -345,7 +348,9 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
 
@@ -357,7 +362,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:t:b:f:hv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "y:r:t:b:f:hvT:B:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -368,6 +373,14 @@ int main(int argc, char** argv) {
 	  case 'y':
 	    type = optarg;
 	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(targetIndex, optarg);
 	    cerr << "INFO: there are " << targetIndex.size() << " individuals in the target" << endl;
@@ -409,6 +422,8 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     if(filename == "NA"){
       cerr << "FATAL: did not specify a file" << endl;
       printHelp();
@@ -467,21 +482,24 @@ int main(int argc, char** argv) {
 
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
+
+    vector<char> targetMember     = sampleMembership(samples, targetIndex, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, backgroundIndex, backgroundNames, "background");
     
     vector<int> ibi, iti, itot;
 
-    int index, indexi = 0;
+    int index = 0, indexi = 0;
 
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
       
       string samplename  = (*samp) ;
 
-      if(targetIndex.find(index) != targetIndex.end() ){
+      if(targetMember[index]){
         iti.push_back(indexi);
 	//	itot.push_back(indexi);
 	indexi++;
       }
-      if(backgroundIndex.find(index) != backgroundIndex.end()){
+      if(backgroundMember[index]){
         ibi.push_back(indexi);
 	//	itot.push_back(indexi);
 	indexi++;
@@ -502,6 +520,14 @@ int main(int argc, char** argv) {
     string currentSeqid = "NA";
 
     int count = 0;    
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget     = newGenotype(format);
+    genotype * populationBackground = newGenotype(format);
+    genotype * populationTotal      = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
       count++;
       //cerr << count << endl;
@@ -526,50 +552,31 @@ int main(int argc, char** argv) {
 	afs.clear();
       }
       
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
 
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 	
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
         
-	if(targetIndex.find(sindex) != targetIndex.end() ){
-	  target.push_back(sample);
-	  total.push_back(sample);	  
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
-	if(backgroundIndex.find(sindex) != backgroundIndex.end()){
-	  background.push_back(sample);
-	  total.push_back(sample);	  
+	if(backgroundMember[sindex]){
+	  background.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
 	
 	sindex += 1;
       }
             
-      genotype * populationTarget    ;
-      genotype * populationBackground;
-      genotype * populationTotal     ;
-      
-      if(type == "PL"){
-	populationTarget     = new pl();
-	populationBackground = new pl();
-	populationTotal      = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-	populationBackground = new gl();
-	populationTotal      = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-	populationBackground = new gp();
-	populationTotal      = new gp();
-      }
-      if(type == "GT"){
-        populationTarget     = new gt();
-	populationBackground = new gt();
-        populationTotal      = new gt();
-      }
+      populationTarget->reset();
+      populationBackground->reset();
+      populationTotal->reset();
 
      
       populationTarget->loadPop(target,         var.sequenceName, var.position);
@@ -580,13 +587,6 @@ int main(int argc, char** argv) {
       
       
       if(populationTotal->af > 0.95 || populationTotal->af < 0.05){
-	delete populationTarget;
-	delete populationBackground;
-	delete populationTotal;
-	
-	populationTarget     = NULL;
-	populationBackground = NULL;
-	populationTotal      = NULL;
 	continue;
       }
 
@@ -596,13 +596,7 @@ int main(int argc, char** argv) {
 	positions.push_back(var.position);
 	loadPhased(haplotypes, populationTotal, nsamples);      
 	
-	delete populationTarget;
-	delete populationBackground;
-	delete populationTotal;
 	
-	populationTarget     = NULL;
-	populationBackground = NULL;
-	populationTotal      = NULL;
 	
 
     }
@@ -617,5 +611,9 @@ int main(int argc, char** argv) {
 
     calc(haplotypes, nsamples, positions, afs, iti, ibi, itot, currentSeqid);
     
+    delete populationTarget;
+    delete populationBackground;
+    delete populationTotal;
+
     return 0;		    
 }
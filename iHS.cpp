@@ -3,6 +3,8 @@
 #include "cdflib.h"
 #include "pdflib.h"
 #include "var.h"
+#include "phaselib.h"
+#include "ehhlib.h"
 
 #include <string>
 #include <iostream>
@@ -27,7 +29,7 @@ void printHelp(void){
   cerr << "INFO: help" << endl;
   cerr << "INFO: description:" << endl;
   cerr << "     iHS calculates the integrated ratio of haplotype decay between the reference and non-reference allele. " << endl;
-  cerr << "     This implementation of iHS integrates over a SNP index, NOT a physical distance or genetic distance.   " << endl << endl;
+  cerr << "     EHH is integrated over the SNP index unless a genetic map (--map) or physical distance (--physical) is given. " << endl << endl;
 
   cerr << "Output : 4 columns :                  "    << endl;
   cerr << "     1. seqid                         "    << endl;
@@ -35,14 +37,26 @@ void printHelp(void){
   cerr << "     3. target allele frequency       "    << endl;
   cerr << "     4. integrated EHH (alternative)  "    << endl;
   cerr << "     5. integrated EHH (reference)    "    << endl;
-  cerr << "     6. iHS log(iEHHalt/iEHHref)      "    << endl  << endl;
+  cerr << "     6. iHS log(iEHHalt/iEHHref)      "    << endl;
+  cerr << "     7. standardised iHS (--standardise only; NA if undefined) " << endl << endl;
+  cerr << "Output with --window : seqid, start, end, scores, scores with |standardised iHS| > cutoff, fraction " << endl << endl;
 
   cerr << "INFO: iHS  --target 0,1,2,3,4,5,6,7 --file my.phased.vcf  --region chr1:1-1000 " << endl << endl;
  
   cerr << "INFO: required: t,target  -- argument: a zero base comma separated list of target individuals corrisponding to VCF columns " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: f,file    -- argument: proper formatted and phased VCF.                                                    " << endl;
   cerr << "INFO: required: y,type    -- argument: genotype likelihood format: PL,GL,GP                                                " << endl;
   cerr << "INFO: optional: r,region  -- argument: a tabix compliant genomic range : \"seqid:start-end\" or \"seqid\"                  " << endl; 
+  cerr << "INFO: optional: P,phase   -- flag    : phase the genotypes (or likelihoods) with a Li and Stephens HMM; input may be unphased " << endl;
+  cerr << "INFO: optional: K,states  -- argument: copying states per individual for --phase [16]                                     " << endl;
+  cerr << "INFO: optional: m,map     -- argument: genetic map, one \"seqid position cM\" per line; integrate over cM                    " << endl;
+  cerr << "INFO: optional: p,physical -- flag   : integrate over base pairs rather than the SNP index                                   " << endl;
+  cerr << "INFO: optional: x,max-extend -- argument: stop extending haplotypes this far from the core, in the integration units     " << endl;
+  cerr << "INFO: optional: z,standardise -- flag : standardise iHS to mean 0 and variance 1 within allele frequency bins            " << endl;
+  cerr << "INFO: optional: n,bins    -- argument: number of equal width allele frequency bins for --standardise [20]                    " << endl;
+  cerr << "INFO: optional: w,window  -- argument: report the fraction of extreme scores in non-overlapping windows of this many bp     " << endl;
+  cerr << "INFO: optional: c,cutoff  -- argument: |standardised iHS| counted as extreme by --window [2]                               " << endl;
   cerr << endl;
  
   printVersion();
@@ -50,13 +64,6 @@ void printHelp(void){
   exit(1);
 }
 
-void clearHaplotypes(string haplotypes[][2], int ntarget){
-  for(int i= 0; i < ntarget; i++){
-    haplotypes[i][0].clear();
-    haplotypes[i][1].clear();
-  }
-}
-
 void loadIndices(map<int, int> & index, string set){
   
   vector<string>  indviduals = split(set, ",");
@@ -67,123 +74,261 @@ void loadIndices(map<int, int> & index, string set){
   }
 }
 
-void calc(string haplotypes[][2], int nhaps, vector<double> afs, vector<long int> pos, vector<int> & target, vector<int> & background, string seqid){
+// Raw iHS has to be standardised within allele frequency bins, which
+// needs the mean and variance of every bin over the whole run.  Scores
+// are spilled to a binary temporary file while the bin sums accumulate,
+// then read back in order for the standardised output.
+
+struct ihsRecord{
+  long int position;
+  float    af;
+  float    iHHalt;
+  float    iHHref;
+  int      seqid;
+};
+
+class ihsStandardiser{
+public:
+  ihsStandardiser(int nbins);
+  ~ihsStandardiser(void);
+  void add(string & seqid, long int position, double af, double iHHalt, double iHHref);
+
+  // per site lines, or with window > 0 the fraction of |standardised iHS|
+  // above cutoff in each window of that many base pairs
+
+  void report(long int window, double cutoff);
+
+private:
+  int            nbins;
+  FILE *         spill;
+  vector<string> seqids;
+  vector<double> n, sum, sumsq;
+
+  int  bin(double af);
+  void reportWindow(string & seqid, long int start, long int window, int nscores, int nextreme);
+};
+
+ihsStandardiser::ihsStandardiser(int nbins) : nbins(nbins), n(nbins, 0), sum(nbins, 0), sumsq(nbins, 0){
+  spill = tmpfile();
+  if(spill == NULL){
+    cerr << "FATAL: could not open a temporary file to spill scores" << endl;
+    exit(1);
+  }
+}
 
-   //cerr << "about to calc" << endl;
-   //cerr << "nhap:        " << nhaps << endl;
+ihsStandardiser::~ihsStandardiser(void){
+  fclose(spill);
+}
 
-  for(int snp = 0; snp < haplotypes[0][0].length(); snp++){
-    
-    int breakflag = 1;
-    int count     = 0;
+int ihsStandardiser::bin(double af){
+  int b = int(af * nbins);
+  return b < nbins ? b : nbins - 1;
+}
+
+void ihsStandardiser::add(string & seqid, long int position, double af, double iHHalt, double iHHref){
+
+  if(seqids.empty() || seqids.back() != seqid){
+    seqids.push_back(seqid);
+  }
+
+  ihsRecord record;
+  record.position = position;
+  record.af       = af;
+  record.iHHalt   = iHHalt;
+  record.iHHref   = iHHref;
+  record.seqid    = seqids.size() - 1;
+
+  if(fwrite(&record, sizeof(ihsRecord), 1, spill) != 1){
+    cerr << "FATAL: could not write spilled scores" << endl;
+    exit(1);
+  }
+
+  // the stored floats are what is read back, so the sums use them too
+
+  double score = log(double(record.iHHalt) / double(record.iHHref));
+
+  if(!std::isfinite(score)){
+    return;
+  }
+
+  int b = bin(record.af);
+  n[b]     += 1;
+  sum[b]   += score;
+  sumsq[b] += score * score;
+}
+
+void ihsStandardiser::reportWindow(string & seqid, long int start, long int window, int nscores, int nextreme){
+  if(nscores == 0){
+    return;
+  }
+  cout << seqid << "\t" << start << "\t" << start + window << "\t" << nscores
+       << "\t" << nextreme << "\t" << double(nextreme) / nscores << endl;
+}
+
+void ihsStandardiser::report(long int window, double cutoff){
+
+  vector<double> mean(nbins, 0), sd(nbins, 0);
+
+  for(int b = 0; b < nbins; b++){
+    if(n[b] < 2){
+      continue;
+    }
+    mean[b] = sum[b] / n[b];
+    sd[b]   = sqrt((sumsq[b] - n[b] * mean[b] * mean[b]) / (n[b] - 1));
+    cerr << "INFO: frequency bin " << b << " : " << n[b] << " scores, mean " << mean[b] << ", sd " << sd[b] << endl;
+  }
+
+  rewind(spill);
+
+  ihsRecord record;
+
+  int      seqid    = -1;
+  long int start    = 0;
+  int      nscores  = 0;
+  int      nextreme = 0;
+
+  while(fread(&record, sizeof(ihsRecord), 1, spill) == 1){
+
+    double score = log(double(record.iHHalt) / double(record.iHHref));
+    int    b     = bin(record.af);
+
+    bool   defined      = std::isfinite(score) && n[b] >= 2 && sd[b] > 0;
+    double standardised = defined ? (score - mean[b]) / sd[b] : 0;
+
+    if(window <= 0){
+      cout << seqids[record.seqid] << "\t" << record.position << "\t" << record.af << "\t"
+	   << record.iHHalt << "\t" << record.iHHref << "\t" << score << "\t";
+      if(defined){
+	cout << standardised << endl;
+      }
+      else{
+	cout << "NA" << endl;
+      }
+      continue;
+    }
+
+    if(record.seqid != seqid || record.position >= start + window){
+      if(seqid != -1){
+	reportWindow(seqids[seqid], start, window, nscores, nextreme);
+      }
+      seqid    = record.seqid;
+      start    = (record.position / window) * window;
+      nscores  = 0;
+      nextreme = 0;
+    }
+    if(defined){
+      nscores  += 1;
+      nextreme += fabs(standardised) > cutoff;
+    }
+  }
+  if(seqid != -1){
+    reportWindow(seqids[seqid], start, window, nscores, nextreme);
+  }
+}
+
+// iHH of each allele is the trapezoid integral of its EHH out to each
+// side of the core, a step per site weighted by the distance it adds (one
+// over the SNP index).  Each side stops on its own once both alleles fall
+// below 0.05, at its contig end or at maxExtend.  A forward sweep covers
+// the sites before every core and a backward sweep those after.
+
+void integrateSide(haplotypeMatrix & haplotypes, vector<int> & haps, vector<double> & coordinates, double maxExtend,
+		   int direction, vector<double> & iHHA, vector<double> & iHHR){
+
+  ehhScan scan;
+  scan.start(haplotypes, haps, direction);
+
+  int nsites = haplotypes.nsites;
+
+  while(scan.next()){
+
+    int snp = scan.core();
+
+    scan.decay();
 
     double ehhA = 1;
     double ehhR = 1;
 
-    double iHSA = 0;
-    double iHSR = 0;
+    for(int steps = 1; ehhA >= 0.05 || ehhR >= 0.05; steps++){
 
-    int start = snp;
-    int end   = snp;
-    int core  = snp; 
+      int site = snp - direction * steps;
 
-    while( breakflag ) {
-     
-      if(count > 0){
-	start -= 1;
-	end   += 1;
-      }
-      if(start == -1){
+      if(site < 0 || site >= nsites){
 	break;
       }
-      if(end == haplotypes[0][0].length() - 1){
+      if(maxExtend >= 0 && fabs(coordinates[site] - coordinates[snp]) > maxExtend){
 	break;
       }
-      count += 1;
-
-      map<string , int> targetH;
-
-      double sumrT = 0;
-      double sumaT = 0;
-      double nrefT = 0;
-      double naltT = 0;
-
-      for(int i = 0; i < nhaps; i++){
-	targetH[ haplotypes[i][0].substr(start, (end - start)) ]++;
-	targetH[ haplotypes[i][1].substr(start, (end - start)) ]++;
-      }     
-      for( map<string, int>::iterator th = targetH.begin(); th != targetH.end(); th++){        
-	if( (*th).first.substr((end-start)/2, 1) == "1"){     
-	  sumaT += r8_choose(th->second, 2);  
-	  naltT += th->second;
-	}
-	else{
-	  sumrT += r8_choose(th->second, 2);  
-	  nrefT += th->second;
-	}
-      }
-      cerr << pos[snp] << " " << naltT  << " " << nrefT << endl; 
-      
-      double ehhAC = sumaT / (r8_choose(naltT, 2));
-      double ehhRC = sumrT / (r8_choose(nrefT, 2));
 
-      if(count == 1){
-	ehhA = ehhAC;
-	ehhR = ehhRC;
-	continue;
-      }
+      double step = fabs(coordinates[site] - coordinates[site + direction]);
+
+      double ehhAC = scan.ehh(1, steps);
+      double ehhRC = scan.ehh(0, steps);
 
-      iHSA += (ehhA + ehhAC) / 2;
-      iHSR += (ehhR + ehhRC) / 2;
+      iHHA[snp] += (ehhA + ehhAC) / 2 * step;
+      iHHR[snp] += (ehhR + ehhRC) / 2 * step;
 
       ehhA = ehhAC;
       ehhR = ehhRC;
-
-      if(ehhA < 0.05 && ehhR < 0.05){
-	breakflag = 0;
-      }
-    } 
-
-    cout << seqid << "\t" << pos[snp] << "\t" << afs[snp] << "\t" << iHSA << "\t" << iHSR << "\t" << log(iHSA/iHSR) << endl;
-  }   
+    }
+  }
 }
 
-double EHH(string haplotypes[][2], int nhaps){
+void calc(haplotypeMatrix & haplotypes, vector<double> & afs, vector<long int> & pos, vector<double> & coordinates, vector<int> & haps, double maxExtend, string seqid, ihsStandardiser * standardiser){
 
-  map<string , int> hapcounts;
+  int nsites = haplotypes.nsites;
 
-  for(int i = 0; i < nhaps; i++){
-    hapcounts[ haplotypes[i][0] ]++;
-    hapcounts[ haplotypes[i][1] ]++;
-  }
+  vector<double> iHHA(nsites, 0);
+  vector<double> iHHR(nsites, 0);
 
-  double sum = 0;
-  double nh  = 0;
+  integrateSide(haplotypes, haps, coordinates, maxExtend,  1, iHHA, iHHR);
+  integrateSide(haplotypes, haps, coordinates, maxExtend, -1, iHHA, iHHR);
 
-  for( map<string, int>::iterator it = hapcounts.begin(); it != hapcounts.end(); it++){
-    nh  += it->second; 
-    sum += r8_choose(it->second, 2);
+  for(int snp = 0; snp < nsites; snp++){
+    if(standardiser != NULL){
+      standardiser->add(seqid, pos[snp], afs[snp], iHHA[snp], iHHR[snp]);
+      continue;
+    }
+    cout << seqid << "\t" << pos[snp] << "\t" << afs[snp] << "\t" << iHHA[snp] << "\t" << iHHR[snp] << "\t" << log(iHHA[snp]/iHHR[snp]) << endl;
   }
+}
 
-  double max = (sum /  r8_choose(nh, 2));
-  
-  return max;
+void loadPhased(haplotypeMatrix & haplotypes, genotype * pop){
 
-}
+  // missing calls carry the reference allele
+
+  haplotypes.addSite();
 
-void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    if(gtFirst(*ind)){
+      haplotypes.setAlt(2*indIndex);
+    }
+    if(gtSecond(*ind)){
+      haplotypes.setAlt(2*indIndex + 1);
+    }
     indIndex += 1;
   }
 }
 
+// phases the buffered contig and fills the haplotypes from the copying model
+
+void loadPhaser(haplotypeMatrix & haplotypes, lsPhaser & phaser){
+
+  phaser.phase();
+
+  for(int site = 0; site < phaser.nsites(); site++){
+    haplotypes.addSite();
+    for(int h = 0; h < phaser.nhaplotypes(); h++){
+      if(phaser.allele(h, site)){
+	haplotypes.setAlt(h);
+      }
+    }
+  }
+  phaser.clear();
+}
+
 int main(int argc, char** argv) {
 
   // set the random seed for MCMC
@@ -205,6 +350,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file
+
+  vector<string> targetNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -213,9 +362,28 @@ int main(int argc, char** argv) {
 
   int counts = 0;
   
-  // phased 
+  // phase the genotypes with the copying model rather than require phased input
+
+  int phase  = 0;
+  int states = PHASE_STATES;
+
+  // integrate over cM from a genetic map, over bp, or over the SNP index
+
+  geneticMap gmap;
+
+  int physical = 0;
+
+  // no cap on the extension by default
 
-  int phased = 0;
+  double maxExtend = -1;
+
+  // standardise within allele frequency bins; optionally report the
+  // fraction of extreme scores in windows instead of per site
+
+  int      standardise = 0;
+  int      nbins       = 20;
+  long int window      = 0;
+  double   cutoff      = 2;
 
   string type = "NA";
 
@@ -225,8 +393,18 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
+	{"phase"     , 0, 0, 'P'},
+	{"states"    , 1, 0, 'K'},
+	{"map"       , 1, 0, 'm'},
+	{"physical"  , 0, 0, 'p'},
+	{"max-extend", 1, 0, 'x'},
+	{"standardise", 0, 0, 'z'},
+	{"bins"      , 1, 0, 'n'},
+	{"window"    , 1, 0, 'w'},
+	{"cutoff"    , 1, 0, 'c'},
 	{0,0,0,0}
       };
 
@@ -235,7 +413,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:hv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:hvT:PK:m:px:zn:w:c:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -246,6 +424,46 @@ int main(int argc, char** argv) {
 	  case 'y':
 	    type = optarg;
 	    break;
+	  case 'P':
+	    phase = 1;
+	    cerr << "INFO: phasing genotypes with the Li and Stephens model" << endl;
+	    break;
+	  case 'K':
+	    states = atoi(optarg);
+	    cerr << "INFO: copying states per individual: " << states << endl;
+	    break;
+	  case 'm':
+	    gmap.load(optarg);
+	    cerr << "INFO: genetic map: " << optarg << endl;
+	    break;
+	  case 'p':
+	    physical = 1;
+	    cerr << "INFO: integrating over physical distance" << endl;
+	    break;
+	  case 'x':
+	    maxExtend = atof(optarg);
+	    cerr << "INFO: maximum extension from the core: " << maxExtend << endl;
+	    break;
+	  case 'z':
+	    standardise = 1;
+	    cerr << "INFO: standardising iHS within allele frequency bins" << endl;
+	    break;
+	  case 'n':
+	    nbins = atoi(optarg);
+	    cerr << "INFO: allele frequency bins: " << nbins << endl;
+	    break;
+	  case 'w':
+	    window = atol(optarg);
+	    cerr << "INFO: window size: " << window << endl;
+	    break;
+	  case 'c':
+	    cutoff = atof(optarg);
+	    cerr << "INFO: extreme |iHS| cutoff: " << cutoff << endl;
+	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -282,14 +500,25 @@ int main(int argc, char** argv) {
       return 1;
     }
 
-    if(filename == "NA"){
-      cerr << "FATAL: did not specify a file" << endl;
+    int format = formatType(type);
+
+    if(nbins < 1){
+      cerr << "FATAL: there must be at least one allele frequency bin" << endl;
+      return 1;
+    }
+    if(window > 0 && !standardise){
+      cerr << "FATAL: --window reports standardised scores and needs --standardise" << endl;
       printHelp();
-      return(1);
+      return 1;
     }
 
-    if(it.size() < 2){
-      cerr << "FATAL: target option is required -- or -- less than two individuals in target\n";
+    ihsStandardiser * standardiser = NULL;
+    if(standardise){
+      standardiser = new ihsStandardiser(nbins);
+    }
+
+    if(filename == "NA"){
+      cerr << "FATAL: did not specify a file" << endl;
       printHelp();
       return(1);
     }
@@ -320,17 +549,24 @@ int main(int argc, char** argv) {
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
       
       string sampleName = (*samp);
      
-      if(it.find(index) != it.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
       index++;
     }
-    
+
+    if(target_h.size() < 2){
+      cerr << "FATAL: target option is required -- or -- less than two individuals in target\n";
+      printHelp();
+      return(1);
+    }
     
     // cerr << "n in target : " << target_h.size() << endl;
 
@@ -338,15 +574,36 @@ int main(int argc, char** argv) {
     
     vector<double> afs;
 
-    string haplotypes [target_h.size()][2];    
+    // the contig's haplotypes, the sites they use and their coordinates
+
+    haplotypeMatrix haplotypes;
+    haplotypes.setHaplotypes(2 * target_h.size());
+
+    vector<int> haps;
+    for(int h = 0; h < haplotypes.nhaps; h++){
+      haps.push_back(h);
+    }
+
+    vector<double> coordinates;
     
     string currentSeqid = "NA";
     
     // cerr << "about to loop variants" << endl;
 
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget = newGenotype(format);
+
+    // the phaser buffers each contig when --phase is given
+
+    lsPhaser phaser(format);
+    phaser.setStates(states);
+
     while (variantFile.getNextVariant(var)) {
 
-      if(!var.isPhased()){
+      if(!phase && !var.isPhased()){
 	cerr << "FATAL: Found an unphased variant. All genotypes must be phased!" << endl;
 	return(1);
       }
@@ -356,61 +613,68 @@ int main(int argc, char** argv) {
       }
 
       if(currentSeqid != var.sequenceName){
-	if(haplotypes[0][0].length() > 10){
-	  calc(haplotypes, target_h.size(), afs, positions, target_h, background_h, currentSeqid);
+	if(phase){
+	  loadPhaser(haplotypes, phaser);
+	}
+	if(haplotypes.nsites > 10){
+	  siteCoordinates(gmap, physical, currentSeqid, positions, coordinates);
+	  calc(haplotypes, afs, positions, coordinates, haps, maxExtend, currentSeqid, standardiser);
 	}
-	clearHaplotypes(haplotypes, target_h.size());
+	haplotypes.clear();
 	positions.clear();
 	currentSeqid = var.sequenceName;
 	afs.clear();
       }
 
 
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
       
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 	
-	if(it.find(sindex) != it.end() ){
-	  target.push_back(sample);
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
 	}	
 	sindex += 1;
       }
       
-      genotype * populationTarget    ;
-
-      
-      if(type == "PL"){
-	populationTarget     = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-      }
-      if(type == "GT"){
-	populationTarget     = new gt();
-      }
+      populationTarget->reset();
 
       populationTarget->loadPop(target, var.sequenceName, var.position);
       
       if(populationTarget->af > 0.95 || populationTarget->af < 0.05){
-	delete populationTarget;
 	continue;
       }
       positions.push_back(var.position);
       afs.push_back(populationTarget->af);
-      loadPhased(haplotypes, populationTarget, populationTarget->gts.size()); 
+      if(phase){
+	phaser.addSite(populationTarget);
+      }
+      else{
+	loadPhased(haplotypes, populationTarget); 
+      }
     
-      populationTarget = NULL;
-      delete populationTarget;
     }
     
-    calc(haplotypes, target_h.size(), afs, positions, target_h, background_h, currentSeqid);
+    if(phase){
+      loadPhaser(haplotypes, phaser);
+    }
+    if(haplotypes.nsites > 0){
+      siteCoordinates(gmap, physical, currentSeqid, positions, coordinates);
+      calc(haplotypes, afs, positions, coordinates, haps, maxExtend, currentSeqid, standardiser);
+    }
+
+    if(standardiser != NULL){
+      standardiser->report(window, cutoff);
+      delete standardiser;
+    }
     
+    delete populationTarget;
+
     return 0;		    
 }
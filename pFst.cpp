@@ -35,7 +35,9 @@ void printHelp(void){
   cerr << "INFO: usage:  pFst --target 0,1,2,3,4,5,6,7 --background 11,12,13,16,17,19,22 --file my.vcf --deltaaf 0.1 --type PL" << endl;
   cerr << endl;
   cerr << "INFO: required: t,target     -- argument: a zero based comma separated list of target individuals corrisponding to VCF columns       "  << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: b,background -- argument: a zero based comma separated list of background individuals corrisponding to VCF columns   "  << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
   cerr << "INFO: required: f,file       -- argument: a properly formatted VCF.                                                                  "  << endl;
   cerr << "INFO: required: y,type       -- argument: genotype likelihood format ; genotypes: GP, GL or PL; pooled: PO                           "  << endl;
   cerr << "INFO: optional: d,deltaaf    -- argument: skip sites where the difference in allele frequencies is less than deltaaf, default is zero"  << endl;
@@ -68,11 +70,60 @@ void loadIndices(map<int, int> & index, string set){
   }
 }
 
-double logLbinomial(double x, double n, double p){
+// Sites are scored in batches: the allele counts and frequencies of each
+// site are gathered into contiguous arrays, the likelihood ratio kernel
+// runs over the whole batch, and the p-values are written in site order.
 
-  double ans = lgamma(n+1)-lgamma(x+1)-lgamma(n-x+1) + x * log(p) + (n-x) * log(1-p);
-  return ans;
-    
+#define LRT_BATCH 4096
+
+struct lrtBatch{
+  vector<string>   seqids;
+  vector<long int> positions;
+  vector<double>   x1, n1, p1;
+  vector<double>   x2, n2, p2;
+  vector<double>   p0;
+  vector<double>   stat;
+};
+
+void addSite(lrtBatch & batch, string & seqid, long int position, zvar * target, zvar * background, double p0){
+
+  batch.seqids.push_back(seqid);
+  batch.positions.push_back(position);
+
+  batch.x1.push_back(target->beta);
+  batch.n1.push_back(target->alpha + target->beta);
+  batch.p1.push_back(bound(target->beta / (target->alpha + target->beta)));
+
+  batch.x2.push_back(background->beta);
+  batch.n2.push_back(background->alpha + background->beta);
+  batch.p2.push_back(bound(background->beta / (background->alpha + background->beta)));
+
+  batch.p0.push_back(p0);
+}
+
+void scoreBatch(lrtBatch & batch){
+
+  int n = batch.seqids.size();
+
+  batch.stat.resize(n);
+
+  for(int i = 0; i < n; i++){
+    batch.stat[i] = binomialLrt(batch.x1[i], batch.n1[i], batch.p1[i],
+                                batch.x2[i], batch.n2[i], batch.p2[i], batch.p0[i]);
+  }
+
+  for(int i = 0; i < n; i++){
+    if(batch.stat[i] <= 0){
+      continue;
+    }
+    cout << batch.seqids[i] << "\t"  << batch.positions[i] << "\t" << chiSquareTail1(batch.stat[i]) << endl ;
+  }
+
+  batch.seqids.clear();
+  batch.positions.clear();
+  batch.x1.clear(); batch.n1.clear(); batch.p1.clear();
+  batch.x2.clear(); batch.n2.clear(); batch.p2.clear();
+  batch.p0.clear();
 }
 
 int main(int argc, char** argv) {
@@ -96,6 +147,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -117,7 +172,9 @@ int main(int argc, char** argv) {
 	{"counts"    , 0, 0, 'c'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"deltaaf"   , 1, 0, 'd'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
@@ -129,7 +186,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "r:d:t:b:f:y:chv", longopts, &index);
+	iarg = getopt_long(argc, argv, "r:d:t:b:f:y:chvT:B:", longopts, &index);
 	
 	switch (iarg)
 	  {
@@ -150,6 +207,14 @@ int main(int argc, char** argv) {
 	    cerr << "INFO: using genotype counts rather than genotype likelihoods" << endl;
 	    counts = 1;
 	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(ib, optarg);
 	    cerr << "INFO: There are " << ib.size() << " individuals in the target" << endl;
@@ -219,11 +284,26 @@ int main(int argc, char** argv) {
       return 1;
     }    
 
+    int format = formatType(type);
+
     Variant var(variantFile);
 
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, ib, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, it, backgroundNames, "background");
+
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    zvar * populationTarget     = newPopulation(format);
+    zvar * populationBackground = newPopulation(format);
+    zvar * populationTotal      = newPopulation(format);
+
+    lrtBatch batch;
+
     while (variantFile.getNextVariant(var)) {
 
       if(var.alt.size() > 1){
@@ -231,67 +311,39 @@ int main(int argc, char** argv) {
       }
       
         
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
 	        
 	int index = 0;
 
         for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-          map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+          map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 
 	    if(sample["GT"].front() != "./."){
-	      if(it.find(index) != it.end() ){
-		target.push_back(sample);		
-		total.push_back(sample);		
+	      if(backgroundMember[index]){
+		target.push_back(&sample);		
+		total.push_back(&sample);		
 	      }
-	      if(ib.find(index) != ib.end()){
-		background.push_back(sample);
-		total.push_back(sample);		
+	      if(targetMember[index]){
+		background.push_back(&sample);
+		total.push_back(&sample);		
 	      }
 	    }
             
 	index += 1;
 	}
 	
-	zvar * populationTarget        ;
-	zvar * populationBackground    ;
-	zvar * populationTotal         ;
-
-	if(type == "PO"){
-	  populationTarget     = new pooled();
-          populationBackground = new pooled();
-          populationTotal      = new pooled();
-	}
-	if(type == "PL"){
-	  populationTarget     = new pl();
-	  populationBackground = new pl();
-	  populationTotal      = new pl();
-	}
-	if(type == "GL"){
-	  populationTarget     = new gl();
-	  populationBackground = new gl();
-	  populationTotal      = new gl();	  
-	}
-	if(type == "GP"){
-	  populationTarget     = new gp();
-	  populationBackground = new gp();
-	  populationTotal      = new gp();
-	}
-	if(type == "GT"){
-          populationTarget     = new gt();
-          populationBackground = new gt();
-          populationTotal      = new gt();
-        }	
+	populationTarget->reset();
+	populationBackground->reset();
+	populationTotal->reset();
 
 	populationTotal->loadPop(total          , var.sequenceName, var.position);	
 	populationTarget->loadPop(target        , var.sequenceName, var.position);
 	populationBackground->loadPop(background, var.sequenceName, var.position);
 
 	if(populationTarget->npop < 2 || populationBackground->npop < 2){
-          delete populationTarget;
-	  delete populationBackground;
-          delete populationTotal;
-
 	  continue;
 	}
 
@@ -300,11 +352,6 @@ int main(int argc, char** argv) {
 	populationBackground->estimatePosterior();
 
 	if(populationTarget->alpha == -1 || populationBackground->alpha == -1){
-	  delete populationTarget;
-	  delete populationBackground;
-	  delete populationTotal;
-
-
           continue;
         }
 
@@ -323,48 +370,19 @@ int main(int argc, char** argv) {
 	}
 
 	double populationTotalEstAF       = bound(populationTotal->beta      / (populationTotal->alpha      + populationTotal->beta)     );
-	double populationTargetEstAF      = bound(populationTarget->beta     / (populationTarget->alpha     + populationTarget->beta)    );
-	double populationBackgroundEstAF  = bound(populationBackground->beta / (populationBackground->alpha + populationBackground->beta));
-
-	// cout << populationTotalEstAF << "\t" << populationTotal->af << endl;
-
-	// x, n, p
-	double null = logLbinomial(populationTarget->beta, (populationTarget->alpha + populationTarget->beta),  populationTotalEstAF) +
-	  logLbinomial(populationBackground->beta, (populationBackground->alpha + populationBackground->beta),  populationTotalEstAF) ;
-	double alt  = logLbinomial(populationTarget->beta, (populationTarget->alpha + populationTarget->beta),  populationTargetEstAF) +
-	  logLbinomial(populationBackground->beta, (populationBackground->alpha + populationBackground->beta),  populationBackgroundEstAF) ;
-		
-	double l = 2 * (alt - null);
-	
-	if(l <= 0){
-	  delete populationTarget;
-	  delete populationBackground;
-	  delete populationTotal;
 
+	addSite(batch, var.sequenceName, var.position, populationTarget, populationBackground, populationTotalEstAF);
 
-	  continue;
+	if(batch.seqids.size() >= LRT_BATCH){
+	  scoreBatch(batch);
 	}
+    }
 
-	int     which = 1;
-	double  p ;
-	double  q ;
-	double  x  = l;
-	double  df = 1;
-	int     status;
-	double  bound ;
-	
-	cdfchi(&which, &p, &q, &x, &df, &status, &bound );
-	
-	cout << var.sequenceName << "\t"  << var.position << "\t" << 1-p << endl ;
-	
-	delete populationTarget;
-	delete populationBackground;
-	delete populationTotal;
-	
-	populationTarget     = NULL;
-	populationBackground = NULL;
-	populationTotal      = NULL;
+    scoreBatch(batch);
+
+    delete populationTarget;
+    delete populationBackground;
+    delete populationTotal;
 
-    }
     return 0;		    
 }
@@ -47,30 +47,76 @@ THE SOFTWARE.
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <getopt.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
 
 struct options{
   std::string file;
+  std::string format;
+  std::vector<int> columns;
   int npermutation;
   int nsuc; 
+  int exact;
+  int clamp;
+  long int memory;
+  std::string tail;
+  std::string fdr;
+  double lambda;
 }globalOpts;
 
-static const char *optString = "f:n:s:";
+static const char *optString = "f:n:s:eo:c:m:t:q:l:h";
+
+static struct option longopts[] =
+  {
+    {"help"         , 0, 0, 'h'},
+    {"file"         , 1, 0, 'f'},
+    {"number"       , 1, 0, 'n'},
+    {"success"      , 1, 0, 's'},
+    {"exact"        , 0, 0, 'e'},
+    {"format"       , 1, 0, 'o'},
+    {"columns"      , 1, 0, 'c'},
+    {"memory"       , 1, 0, 'm'},
+    {"tail"         , 1, 0, 't'},
+    {"fdr"          , 1, 0, 'q'},
+    {"lambda"       , 1, 0, 'l'},
+    {0,0,0,0}
+  };
+
+// scores per block of the sorted spill file; one block is read per lookup
+
+#define FENCE 4096
 
 using namespace std;
 
+void printHelp();
 
 //-------------------------------   OPTIONS   --------------------------------
 int parseOpts(int argc, char** argv)
     {
     int opt = 0;
-    globalOpts.file = "NA";
+    int index;
+    globalOpts.file   = "NA";
+    globalOpts.format = "wcFst";
 
     globalOpts.nsuc         = 1;
     globalOpts.npermutation = 1000;
+    globalOpts.exact        = 0;
+    globalOpts.clamp        = 0;
+    globalOpts.memory       = 100000000;
+    globalOpts.tail         = "upper";
+    globalOpts.fdr          = "NA";
+    globalOpts.lambda       = 0.5;
     
-    opt = getopt(argc, argv, optString);
+    opt = getopt_long(argc, argv, optString, longopts, &index);
     while(opt != -1){
       switch(opt){
+      case 'h':
+	{
+	  printHelp();
+	  exit(0);
+	}
       case 'f':
 	{
 	  globalOpts.file =  optarg;
@@ -88,13 +134,79 @@ int parseOpts(int argc, char** argv)
 	  cerr << "INFO: permuteGPAT++ will stop permutations after N successes: " << globalOpts.nsuc << endl;
 	  break;
 	}
+      case 'e':
+	{
+	  globalOpts.exact = 1;
+	  cerr << "INFO: permuteGPAT++ will report exact empirical p-values" << endl;
+	  break;
+	}
+      case 'o':
+	{
+	  globalOpts.format = optarg;
+	  cerr << "INFO: specified input format : " << optarg << endl;
+	  break;
+	}
+      case 'c':
+	{
+	  vector<string> cols = split(string(optarg), ",");
+	  for(vector<string>::iterator it = cols.begin(); it != cols.end(); it++){
+	    int col = atoi((*it).c_str());
+	    if(col < 1){
+	      cerr << "FATAL: columns are numbered from one: " << *it << endl;
+	      exit(1);
+	    }
+	    globalOpts.columns.push_back(col - 1);
+	  }
+	  cerr << "INFO: permuteGPAT++ will annotate columns: " << optarg << endl;
+	  break;
+	}
+      case 'm':
+	{
+	  globalOpts.memory = atol(optarg);
+	  if(globalOpts.memory < FENCE){
+	    cerr << "FATAL: memory must be at least " << FENCE << " scores" << endl;
+	    exit(1);
+	  }
+	  cerr << "INFO: permuteGPAT++ will hold at most N scores in memory: " << globalOpts.memory << endl;
+	  break;
+	}
+      case 't':
+	{
+	  globalOpts.tail = optarg;
+	  if(globalOpts.tail != "upper" && globalOpts.tail != "lower" && globalOpts.tail != "two"){
+	    cerr << "FATAL: tail must be upper, lower or two: " << optarg << endl;
+	    exit(1);
+	  }
+	  cerr << "INFO: permuteGPAT++ will report " << optarg << " tail p-values" << endl;
+	  break;
+	}
+      case 'q':
+	{
+	  globalOpts.fdr = optarg;
+	  if(globalOpts.fdr != "bh" && globalOpts.fdr != "storey"){
+	    cerr << "FATAL: fdr must be bh or storey: " << optarg << endl;
+	    exit(1);
+	  }
+	  cerr << "INFO: permuteGPAT++ will report " << optarg << " q-values" << endl;
+	  break;
+	}
+      case 'l':
+	{
+	  globalOpts.lambda = atof(optarg);
+	  if(globalOpts.lambda <= 0 || globalOpts.lambda >= 1){
+	    cerr << "FATAL: lambda must be between zero and one: " << optarg << endl;
+	    exit(1);
+	  }
+	  cerr << "INFO: permuteGPAT++ will estimate pi0 with lambda: " << optarg << endl;
+	  break;
+	}
       case '?':
 	{
 	  break;
 	}
       }
       
-      opt = getopt( argc, argv, optString ); 
+      opt = getopt_long(argc, argv, optString, longopts, &index);
     }
     return 1;
     }
@@ -114,24 +226,469 @@ void printHelp()
   cerr << "INFO: help" << endl;
   cerr << "INFO: description:" << endl;
   cerr << "     permuteGPAT++ is a method for adding empirical p-values to a GPAT++ score." << endl ;
-  cerr << "     Currently permuteGPAT++ only supports wcFst, but will be extended.    " << endl ;
+  cerr << "     The scores of each column are compared against all scores in that column. " << endl ;
   cerr << endl;
-  cerr << "OUTPUT: permuteGPAT++ will append three additional columns:" << endl;
+  cerr << "OUTPUT: permuteGPAT++ will append three additional columns per score column:" << endl;
   cerr << "        1. The number of successes                         " << endl;
   cerr << "        2. The number of trials                            " << endl;
-  cerr << "        3. The empirical p-value                           " << endl << endl; 
+  cerr << "        3. The empirical p-value                           " << endl;
+  cerr << "        4. The q-value, only with -q                       " << endl << endl; 
 
   cerr << "INFO: usage:  permuteGPAT++ -f gpat.txt -n 5 -s 1 "<< endl;
+  cerr << "INFO: usage:  permuteGPAT++ --format iHS -f gpat.txt -e "<< endl;
   cerr << endl;
   cerr << "INFO: file:    f   -- argument: the input file     "<< endl;
   cerr << "INFO: number:  n   -- argument: the number of permutations to run for each value [1000]" << endl;
   cerr << "INFO: success: s   -- argument: stop permutations after \'s\' successes [1]"             << endl;
+  cerr << "INFO: exact:   e   -- switch  : compare each value against every score in the file rather than" << endl;
+  cerr << "                                 sampling; the trials column is then the number of scores     " << endl;
+  cerr << "INFO: format:  o   -- argument: format of input file, case sensative [wcFst]                  " << endl;
+  cerr << "                                 availible format options:                                    " << endl;
+  cerr << "                                   wcFst, pFst, bFst, iHS, xpEHH, hapLrt, cqf, deltaAf, abba-baba" << endl;
+  cerr << "INFO: columns: c   -- argument: comma separated score columns, numbered from one; overrides -o " << endl;
+  cerr << "INFO: memory:  m   -- argument: scores held in memory before spilling to disk [100000000]   " << endl;
+  cerr << "INFO: tail:    t   -- argument: upper, lower or two; two doubles the smaller tail [upper]     " << endl;
+  cerr << "INFO: fdr:     q   -- argument: bh or storey q-values, requires -e                             " << endl;
+  cerr << "INFO: lambda:  l   -- argument: p-value threshold for the storey estimate of pi0 [0.5]         " << endl;
 
 
   cerr << endl;
 
 }
 
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : a format name
+
+ Function does   : looks up the score column of a GPAT++ format; the
+                   columns match smoother
+
+ Function returns: the zero based column, or -1 for unknown formats
+
+*/
+int formatColumn(string & format){
+  if(format == "pFst" || format == "abba-baba"){
+    return 2;
+  }
+  if(format == "wcFst" || format == "deltaAf" || format == "hapLrt"){
+    return 4;
+  }
+  if(format == "iHS" || format == "xpEHH" || format == "cqf"){
+    return 5;
+  }
+  if(format == "bFst"){
+    return 8;
+  }
+  return -1;
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : the number of scores
+
+ Function does   : draws a uniform index; rejection sampling removes the
+                   bias of rand() % n towards low indices.  Two draws are
+                   combined when there are more scores than RAND_MAX.
+
+ Function returns: an index in [0, n)
+
+*/
+long int randomIndex(long int n){
+
+  if(n <= RAND_MAX){
+    int limit = RAND_MAX - (RAND_MAX % n);
+    int r     = rand();
+    while(r >= limit){
+      r = rand();
+    }
+    return r % n;
+  }
+
+  unsigned long long range = (unsigned long long)RAND_MAX + 1;
+  unsigned long long span  = range * range;
+  unsigned long long limit = span - (span % n);
+  unsigned long long r     = rand() * range + rand();
+  while(r >= limit){
+    r = rand() * range + rand();
+  }
+  return r % n;
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ The scores of one column, sorted for counting.  Scores are buffered in
+ memory; a full buffer is sorted and spilled to a temporary file, and
+ the spills are merged into one sorted file.  Every FENCE-th merged
+ score is kept in memory so a lookup reads a single block.
+*/
+
+class scoreDistribution{
+private:
+  vector<double> buffer;
+  vector<double> block ;
+  vector<double> fence ;
+  vector<FILE *> spills;
+  FILE *         merged;
+  long int       n     ;
+  long int       limit ;
+
+  void     spill(void);
+  void     merge(void);
+  long int countUpTo(double value, bool inclusive);
+
+public:
+  scoreDistribution(long int limit);
+  ~scoreDistribution(void);
+  void     add(double score);
+  void     finish(void);
+  long int size(void);
+  long int countAbove(double value);
+  long int countBelow(double value);
+  void     runs(vector< pair<double, long int> > & out);
+};
+
+scoreDistribution::scoreDistribution(long int limit) : merged(NULL), n(0), limit(limit){}
+
+scoreDistribution::~scoreDistribution(void){
+  for(vector<FILE *>::iterator it = spills.begin(); it != spills.end(); it++){
+    fclose(*it);
+  }
+  if(merged != NULL){
+    fclose(merged);
+  }
+}
+
+void scoreDistribution::add(double score){
+  // nan scores cannot be ranked
+  if(score != score){
+    return;
+  }
+  buffer.push_back(score);
+  n += 1;
+  if((long int)buffer.size() >= limit){
+    spill();
+  }
+}
+
+void scoreDistribution::spill(void){
+  sort(buffer.begin(), buffer.end());
+
+  FILE * fh = tmpfile();
+  if(fh == NULL){
+    cerr << "FATAL: could not open a temporary file to spill scores" << endl;
+    exit(1);
+  }
+  if(fwrite(&buffer[0], sizeof(double), buffer.size(), fh) != buffer.size()){
+    cerr << "FATAL: could not write spilled scores" << endl;
+    exit(1);
+  }
+  rewind(fh);
+  spills.push_back(fh);
+  buffer.clear();
+}
+
+void scoreDistribution::merge(void){
+
+  merged = tmpfile();
+  if(merged == NULL){
+    cerr << "FATAL: could not open a temporary file to merge scores" << endl;
+    exit(1);
+  }
+
+  priority_queue< pair<double, int>, vector< pair<double, int> >, greater< pair<double, int> > > heads;
+
+  double score;
+
+  for(unsigned int i = 0; i < spills.size(); i++){
+    if(fread(&score, sizeof(double), 1, spills[i]) == 1){
+      heads.push(make_pair(score, i));
+    }
+  }
+
+  long int written = 0;
+
+  while(!heads.empty()){
+    pair<double, int> head = heads.top();
+    heads.pop();
+
+    if(written % FENCE == 0){
+      fence.push_back(head.first);
+    }
+    fwrite(&head.first, sizeof(double), 1, merged);
+    written += 1;
+
+    if(fread(&score, sizeof(double), 1, spills[head.second]) == 1){
+      heads.push(make_pair(score, head.second));
+    }
+  }
+  if(fflush(merged) != 0 || written != n){
+    cerr << "FATAL: could not merge spilled scores" << endl;
+    exit(1);
+  }
+  for(vector<FILE *>::iterator it = spills.begin(); it != spills.end(); it++){
+    fclose(*it);
+  }
+  spills.clear();
+}
+
+void scoreDistribution::finish(void){
+  if(spills.empty()){
+    sort(buffer.begin(), buffer.end());
+    return;
+  }
+  if(!buffer.empty()){
+    spill();
+  }
+  vector<double>().swap(buffer);
+
+  cerr << "INFO: merging score spill files" << endl;
+
+  merge();
+}
+
+long int scoreDistribution::size(void){
+  return n;
+}
+
+long int scoreDistribution::countUpTo(double value, bool inclusive){
+  if(merged == NULL){
+    if(inclusive){
+      return upper_bound(buffer.begin(), buffer.end(), value) - buffer.begin();
+    }
+    return lower_bound(buffer.begin(), buffer.end(), value) - buffer.begin();
+  }
+
+  // every score before the block is counted, no score after it is
+
+  long int b;
+  if(inclusive){
+    b = upper_bound(fence.begin(), fence.end(), value) - fence.begin();
+  }
+  else{
+    b = lower_bound(fence.begin(), fence.end(), value) - fence.begin();
+  }
+  if(b == 0){
+    return 0;
+  }
+
+  long int start = (b - 1) * FENCE;
+  long int count = min((long int)FENCE, n - start);
+
+  block.resize(count);
+
+  if(fseek(merged, start * sizeof(double), SEEK_SET) != 0
+     || fread(&block[0], sizeof(double), count, merged) != (size_t)count){
+    cerr << "FATAL: could not read merged scores" << endl;
+    exit(1);
+  }
+  if(inclusive){
+    return start + (upper_bound(block.begin(), block.end(), value) - block.begin());
+  }
+  return start + (lower_bound(block.begin(), block.end(), value) - block.begin());
+}
+
+long int scoreDistribution::countAbove(double value){
+  return n - countUpTo(value, true);
+}
+
+long int scoreDistribution::countBelow(double value){
+  return countUpTo(value, false);
+}
+
+void scoreDistribution::runs(vector< pair<double, long int> > & out){
+
+  out.clear();
+
+  if(merged == NULL){
+    for(vector<double>::iterator it = buffer.begin(); it != buffer.end(); it++){
+      if(out.empty() || out.back().first != *it){
+	out.push_back(make_pair(*it, 0L));
+      }
+      out.back().second += 1;
+    }
+    return;
+  }
+
+  block.resize(FENCE);
+  rewind(merged);
+
+  size_t count;
+  while((count = fread(&block[0], sizeof(double), FENCE, merged)) > 0){
+    for(size_t i = 0; i < count; i++){
+      if(out.empty() || out.back().first != block[i]){
+	out.push_back(make_pair(block[i], 0L));
+      }
+      out.back().second += 1;
+    }
+  }
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : the scores strictly above and below a value
+
+ Function does   : counts the successes in the requested tail; the two
+                   tailed count doubles the smaller tail
+
+ Function returns: the number of successes
+
+*/
+long int tailSuccesses(long int above, long int below){
+  if(globalOpts.tail == "lower"){
+    return below;
+  }
+  if(globalOpts.tail == "two"){
+    return 2 * min(above, below);
+  }
+  return above;
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : a random rank, the scores strictly above and below a
+                   value and the number of scores
+
+ Function does   : a random score beats the value exactly when its rank in
+                   the sorted scores falls in the tail
+
+ Function returns: true for a success
+
+*/
+bool tailDraw(long int r, long int above, long int below, long int n){
+  if(globalOpts.tail == "lower"){
+    return r < below;
+  }
+  if(globalOpts.tail == "two"){
+    long int m = min(above, below);
+    return r < m || r >= n - m;
+  }
+  return r >= n - above;
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Every non-nan score of a column is also a line of the file, so in exact
+ mode each line's p-value is a function of its score's rank.  The q-values
+ are therefore computed from the sorted scores alone: the success count of
+ each distinct score is tallied, ranked and run through Benjamini-Hochberg,
+ with Storey's pi0 as an optional multiplier.  The table holds one entry
+ per distinct success count.
+*/
+
+struct fdrTable{
+  vector<long int> successes;
+  vector<double>   qvalues;
+};
+
+double exactPvalue(long int suc, long int n){
+  if(suc == 0){
+    return 1.0 / n;
+  }
+  return double(suc) / n;
+}
+
+void buildFdr(scoreDistribution * dist, fdrTable & table){
+
+  long int n = dist->size();
+
+  vector< pair<double, long int> > scores;
+  dist->runs(scores);
+
+  vector< pair<long int, long int> > tally;
+
+  long int before = 0;
+  for(vector< pair<double, long int> >::iterator it = scores.begin(); it != scores.end(); it++){
+    long int above = n - before - it->second;
+    tally.push_back(make_pair(tailSuccesses(above, before), it->second));
+    before += it->second;
+  }
+  vector< pair<double, long int> >().swap(scores);
+
+  sort(tally.begin(), tally.end());
+
+  table.successes.clear();
+  table.qvalues.clear();
+
+  vector<long int> ranks;
+
+  long int rank = 0;
+  for(vector< pair<long int, long int> >::iterator it = tally.begin(); it != tally.end(); it++){
+    rank += it->second;
+    if(!table.successes.empty() && table.successes.back() == it->first){
+      ranks.back() = rank;
+      continue;
+    }
+    table.successes.push_back(it->first);
+    ranks.push_back(rank);
+  }
+
+  double pi0 = 1;
+
+  if(globalOpts.fdr == "storey"){
+    double over = 0;
+    for(vector< pair<long int, long int> >::iterator it = tally.begin(); it != tally.end(); it++){
+      if(exactPvalue(it->first, n) > globalOpts.lambda){
+	over += it->second;
+      }
+    }
+    pi0 = min(1.0, over / (n * (1 - globalOpts.lambda)));
+    cerr << "INFO: storey pi0 estimate: " << pi0 << endl;
+  }
+
+  table.qvalues.resize(table.successes.size());
+
+  double running = 1;
+  for(long int i = table.successes.size() - 1; i >= 0; i--){
+    double q = pi0 * exactPvalue(table.successes[i], n) * n / ranks[i];
+    running  = min(running, q);
+    table.qvalues[i] = running;
+  }
+}
+
+double lookupFdr(fdrTable & table, long int suc){
+  return table.qvalues[lower_bound(table.successes.begin(), table.successes.end(), suc) - table.successes.begin()];
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : a split GPAT++ line and a column
+
+ Function does   : pulls out the score, negative Fst values are set to zero
+
+ Function returns: the score
+
+*/
+double columnScore(vector<string> & region, int column){
+  double score = atof(region[column].c_str());
+
+  if(globalOpts.clamp == 1 && score < 0){
+    score = 0;
+  }
+  return score;
+}
+
+//------------------------------- SUBROUTINE --------------------------------
+/*
+ Function input  : a GPAT++ line
+
+ Function does   : splits the line and checks every score column is present
+
+ Function returns: the split line
+
+*/
+vector<string> splitLine(string & line){
+  vector<string> region = split(line, "\t");
+
+  for(vector<int>::iterator it = globalOpts.columns.begin();
+      it != globalOpts.columns.end(); it++){
+    if(*it >= (int)region.size()){
+      cerr << "FATAL: line has no column " << (*it) + 1 << ": " << line << endl;
+      exit(1);
+    }
+  }
+  return region;
+}
+
 //-------------------------------    MAIN     --------------------------------
 /*
  Comments:
@@ -147,8 +704,30 @@ int parse = parseOpts(argc, argv);
    exit(1);
  }
 
+ if(globalOpts.columns.empty()){
+   int column = formatColumn(globalOpts.format);
+   if(column < 0){
+     cerr << "FATAL: unacceptable input file format, see --format " << endl;
+     printHelp();
+     exit(1);
+   }
+   globalOpts.columns.push_back(column);
+   // Fst estimates below zero are treated as zero
+   if(globalOpts.format == "wcFst"){
+     globalOpts.clamp = 1;
+   }
+ }
+
+ if(globalOpts.fdr != "NA" && globalOpts.exact == 0){
+   cerr << "FATAL: q-values need exact p-values, use -e" << endl;
+   exit(1);
+ }
 
- vector<double> data;
+ vector<scoreDistribution *> data;
+
+ for(unsigned int c = 0; c < globalOpts.columns.size(); c++){
+   data.push_back(new scoreDistribution(max((long int)FENCE, globalOpts.memory / (long int)globalOpts.columns.size())));
+ }
 
  ifstream gpat (globalOpts.file.c_str());
 
@@ -157,15 +736,10 @@ int parse = parseOpts(argc, argv);
  if(gpat.is_open()){
 
    while(getline(gpat, line)){
-     vector<string> region = split(line, "\t");
-     // will change for other output
-     double fst = atof(region[4].c_str());
-
-     if(fst < 0){
-       fst = 0;
+     vector<string> region = splitLine(line);
+     for(unsigned int c = 0; c < globalOpts.columns.size(); c++){
+       data[c]->add(columnScore(region, globalOpts.columns[c]));
      }
-
-     data.push_back(fst);
    }
  }
  else{
@@ -176,40 +750,77 @@ int parse = parseOpts(argc, argv);
  gpat.clear();
  gpat.seekg(0, gpat.beg);
 
- cerr << "INFO: read values to permute: " << data.size() << endl;
+ for(unsigned int c = 0; c < globalOpts.columns.size(); c++){
+   data[c]->finish();
+
+   cerr << "INFO: read values to permute in column " << globalOpts.columns[c] + 1 << ": " << data[c]->size() << endl;
+
+   if(data[c]->size() == 0){
+     cerr << "FATAL: no values to permute in column " << globalOpts.columns[c] + 1 << " of: " << globalOpts.file << endl;
+     exit(1);
+   }
+ }
+
+ vector<fdrTable> fdr(globalOpts.columns.size());
+
+ if(globalOpts.fdr != "NA"){
+   for(unsigned int c = 0; c < globalOpts.columns.size(); c++){
+     buildFdr(data[c], fdr[c]);
+   }
+ }
 
  srand (time(NULL));
 
  if(gpat.is_open()){
 
    while(getline(gpat, line)){
-     vector<string> region = split(line, "\t");
 
-     double value = atof(region[4].c_str());
-     
-     if(value < 0){
-       value = 0;
-     }
-     
+     vector<string> region = splitLine(line);
+
+     cout << line;
 
-     double suc   = 0;
-     double per   = 0;
-     int    datas = data.size();
-     double pv = (1.0 / globalOpts.npermutation);     
+     for(unsigned int c = 0; c < globalOpts.columns.size(); c++){
 
-     while( suc < globalOpts.nsuc && per < globalOpts.npermutation){
-       per += 1.0;
-       
-       int r = rand() % datas;
+       double value = columnScore(region, globalOpts.columns[c]);
 
-       if(value < data[r]){
-	 suc += 1;
+       if(value != value){
+	 cout << "\tNA\tNA\tNA";
+	 if(globalOpts.fdr != "NA"){
+	   cout << "\tNA";
+	 }
+	 continue;
+       }
+
+       double   suc   = 0;
+       double   per   = 0;
+       long int datas = data[c]->size();
+       long int above = data[c]->countAbove(value);
+       long int below = data[c]->countBelow(value);
+       double   pv    = (1.0 / globalOpts.npermutation);
+
+       if(globalOpts.exact == 1){
+	 suc = tailSuccesses(above, below);
+	 per = datas;
+	 pv  = 1.0 / per;
+       }
+       else{
+	 while( suc < globalOpts.nsuc && per < globalOpts.npermutation){
+	   per += 1.0;
+
+	   if(tailDraw(randomIndex(datas), above, below, datas)){
+	     suc += 1;
+	   }
+	 }
+       }
+       if(suc > 0){
+	 pv = suc / per;
+       }
+       cout << "\t" << suc << "\t" << per << "\t" << pv;
+       if(globalOpts.fdr != "NA"){
+	 cout << "\t" << lookupFdr(fdr[c], (long int)suc);
        }
      }
-     if(suc > 0){
-       pv = suc / per;
-     }
-     cout << line << "\t" << suc << "\t" << per << "\t" << pv << endl;
+     cout << endl;
    }
    
  }
@@ -218,6 +829,9 @@ int parse = parseOpts(argc, argv);
    exit(1);
  }
 
+ for(vector<scoreDistribution *>::iterator it = data.begin(); it != data.end(); it++){
+   delete *it;
+ }
 
 return 0;
 }
@@ -0,0 +1,487 @@
+#include "phaselib.h"
+
+#include <algorithm>
+#include <utility>
+
+// splitmix64; each individual and iteration gets its own stream so the
+// result does not depend on the number of threads
+
+struct lsRng{
+  unsigned long long state;
+};
+
+static inline unsigned long long lsNext(lsRng & rng){
+  unsigned long long z = (rng.state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static inline double lsUniform(lsRng & rng){
+  return (lsNext(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline void setAllele(vector<unsigned long long> & haps, int nwords, int hap, int site, int allele){
+  unsigned long long bit = 1ULL << (site & 63);
+  if(allele){
+    haps[hap * nwords + (site >> 6)] |= bit;
+  }
+  else{
+    haps[hap * nwords + (site >> 6)] &= ~bit;
+  }
+}
+
+// index of a draw from (or the largest of) n unnormalised weights
+
+static int choose(const double * w, int n, double total, bool sample, lsRng & rng){
+  if(!sample){
+    int best = 0;
+    for(int i = 1; i < n; i++){
+      if(w[i] > w[best]){
+	best = i;
+      }
+    }
+    return best;
+  }
+  double u = lsUniform(rng) * total;
+  for(int i = 0; i < n - 1; i++){
+    u -= w[i];
+    if(u < 0){
+      return i;
+    }
+  }
+  return n - 1;
+}
+
+lsPhaser::lsPhaser(int format){
+  calls      = (format == FORMAT_GT);
+  states     = PHASE_STATES;
+  iterations = PHASE_ITERATIONS;
+  seed       = 1;
+  clear();
+}
+
+void lsPhaser::setStates(int k){
+  states = k;
+}
+
+void lsPhaser::setIterations(int n){
+  iterations = n;
+}
+
+void lsPhaser::setSeed(unsigned long long s){
+  seed = s;
+}
+
+void lsPhaser::clear(void){
+  nind   = -1;
+  nsite  = 0;
+  nwords = 0;
+  lik.clear();
+  haps.clear();
+}
+
+int lsPhaser::nsites(void){
+  return nsite;
+}
+
+int lsPhaser::nhaplotypes(void){
+  return nind < 0 ? 0 : 2 * nind;
+}
+
+void lsPhaser::addSite(genotype * pop){
+
+  int n = pop->gtCodes.size();
+
+  if(nind == -1){
+    nind = n;
+  }
+  if(n != nind){
+    cerr << "FATAL: phasing needs the same individuals at every site" << endl;
+    exit(1);
+  }
+
+  for(int i = 0; i < n; i++){
+
+    unsigned char code = pop->gtCodes[i];
+
+    if(code & GT_MISSING){
+      lik.push_back(1.0 / 3);
+      lik.push_back(1.0 / 3);
+      lik.push_back(1.0 / 3);
+      continue;
+    }
+    if(calls){
+      int g = gtAltCount(code);
+      for(int j = 0; j < 3; j++){
+	lik.push_back(j == g ? 1 - 2 * PHASE_GT_ERROR : PHASE_GT_ERROR);
+      }
+      continue;
+    }
+    lik.push_back(exp(pop->genoLikelihoods[3*i    ]));
+    lik.push_back(exp(pop->genoLikelihoods[3*i + 1]));
+    lik.push_back(exp(pop->genoLikelihoods[3*i + 2]));
+  }
+  nsite += 1;
+}
+
+// starting haplotypes: the most probable genotype under Hardy-Weinberg,
+// with the allele frequency fitted by EM, and hets given a random phase
+
+void lsPhaser::initialise(void){
+
+  nwords = (nsite + 63) / 64;
+  haps.assign(2 * nind * nwords, 0);
+
+  lsRng rng;
+  rng.state = seed;
+
+  for(int s = 0; s < nsite; s++){
+
+    const float * l = &lik[s * 3 * nind];
+
+    double p = 0.5;
+
+    for(int em = 0; em < 5; em++){
+      double dosage = 0;
+      for(int i = 0; i < nind; i++){
+	double w0 = l[3*i    ] * (1 - p) * (1 - p);
+	double w1 = l[3*i + 1] * 2 * p * (1 - p);
+	double w2 = l[3*i + 2] * p * p;
+	dosage += (w1 + 2 * w2) / (w0 + w1 + w2);
+      }
+      p = dosage / (2 * nind);
+      if(p < 1e-4){
+	p = 1e-4;
+      }
+      if(p > 1 - 1e-4){
+	p = 1 - 1e-4;
+      }
+    }
+
+    for(int i = 0; i < nind; i++){
+      double w[3];
+      w[0] = l[3*i    ] * (1 - p) * (1 - p);
+      w[1] = l[3*i + 1] * 2 * p * (1 - p);
+      w[2] = l[3*i + 2] * p * p;
+
+      int g = choose(w, 3, 0, false, rng);
+
+      int first = (g == 2) || (g == 1 && (lsNext(rng) & 1));
+      setAllele(haps, nwords, 2*i,     s, first);
+      setAllele(haps, nwords, 2*i + 1, s, g - first);
+    }
+  }
+}
+
+void lsPhaser::phase(void){
+
+  if(nsite == 0){
+    return;
+  }
+
+  initialise();
+
+  // every individual is updated from the previous iteration's haplotypes,
+  // so the threads never read what another is writing
+
+  vector<unsigned long long> next;
+
+  for(int it = 0; it < iterations; it++){
+
+    next.assign(haps.size(), 0);
+
+#ifdef HAS_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int i = 0; i < nind; i++){
+      phaseIndividual(i, it, next);
+    }
+    haps.swap(next);
+  }
+}
+
+// true if haplotype h matches one of the chosen references over the window
+
+bool lsPhaser::duplicate(int h, vector<int> & refs, int nref, int w0, int w1){
+  for(int j = 0; j < nref; j++){
+    int w = w0;
+    while(w < w1 && haps[h * nwords + w] == haps[refs[j] * nwords + w]){
+      w++;
+    }
+    if(w == w1){
+      return true;
+    }
+  }
+  return false;
+}
+
+// One pass of the diploid copying model for one individual.  A state is
+// the ordered pair of reference haplotypes (i, j) being copied; with a
+// per site switch probability r on each haplotype the forward step is
+//
+//   f'(i,j) = e(i,j) [ (1-r)^2 f(i,j) + r(1-r)/K (R(i) + R(j)) + r^2/K^2 ]
+//
+// where R holds the row sums of the normalised f, so a site costs O(K^2).
+// The emission only depends on the two reference alleles.  The inner
+// loops run over contiguous rows without branches so they vectorise.  A
+// path is then drawn backwards and the alleles drawn given the path;
+// the last iteration takes the most probable choices instead.
+
+void lsPhaser::phaseIndividual(int ind, int iteration, vector<unsigned long long> & next){
+
+  int own0 = 2 * ind;
+  int own1 = 2 * ind + 1;
+  int nhap = 2 * nind;
+  int K    = min(states, nhap - 2);
+
+  if(K < 1){
+    for(int w = 0; w < nwords; w++){
+      next[own0 * nwords + w] = haps[own0 * nwords + w];
+      next[own1 * nwords + w] = haps[own1 * nwords + w];
+    }
+    return;
+  }
+
+  bool sample = iteration < iterations - 1;
+
+  lsRng rng;
+  rng.state = seed ^ (0xD1B54A32D192ED03ULL * (unsigned long long)(iteration * nind + ind + 1));
+
+  double r = PHASE_SWITCH;
+  double e = PHASE_ERROR;
+  double A = (1 - r) * (1 - r);
+  double B = r * (1 - r) / K;
+  double C = r * r / (double(K) * K);
+  double KK = double(K) * K;
+
+  vector<pair<int, int> > near0, near1;
+  vector<int>    refs(K);
+  vector<char>   used;
+  vector<double> ref;
+  vector<double> forward;
+  vector<double> rows(K);
+  vector<double> erow(K);
+  vector<double> weights(K * K);
+  vector<int>    pathI, pathJ;
+  vector<unsigned char> a, b;
+
+  int step = PHASE_WINDOW_WORDS - PHASE_OVERLAP_WORDS;
+
+  for(int w0 = 0; ; w0 += step){
+
+    int w1 = min(w0 + PHASE_WINDOW_WORDS, nwords);
+    int ws = w0 * 64;
+    int we = min(w1 * 64, nsite);
+    int W  = we - ws;
+
+    // copying states: alternately the next closest haplotype to each of
+    // our own, so both keep candidates even when one is a common type
+
+    near0.clear();
+    near1.clear();
+    for(int h = 0; h < nhap; h++){
+      if(h == own0 || h == own1){
+	continue;
+      }
+      int d0 = 0, d1 = 0;
+      for(int w = w0; w < w1; w++){
+	d0 += __builtin_popcountll(haps[h * nwords + w] ^ haps[own0 * nwords + w]);
+	d1 += __builtin_popcountll(haps[h * nwords + w] ^ haps[own1 * nwords + w]);
+      }
+      near0.push_back(make_pair(d0, h));
+      near1.push_back(make_pair(d1, h));
+    }
+    sort(near0.begin(), near0.end());
+    sort(near1.begin(), near1.end());
+
+    // identical haplotypes add nothing to the model, so only the first
+    // copy of each is taken.  A quarter of the states are drawn at random,
+    // otherwise a group of individuals phased the same wrong way only ever
+    // see each other and the errors are never undone.
+
+    used.assign(nhap, 0);
+
+    int nref  = 0;
+    int nnear = K - K / 4;
+
+    for(int c = 0; nref < nnear && c < 2 * (nhap - 2); c++){
+      int h = (c & 1) ? near1[c / 2].second : near0[c / 2].second;
+      if(!used[h] && !duplicate(h, refs, nref, w0, w1)){
+	used[h] = 1;
+	refs[nref++] = h;
+      }
+    }
+    for(int tries = 0; nref < K && tries < 4 * nhap; tries++){
+      int h = lsNext(rng) % nhap;
+      if(h != own0 && h != own1 && !used[h] && !duplicate(h, refs, nref, w0, w1)){
+	used[h] = 1;
+	refs[nref++] = h;
+      }
+    }
+    for(int h = 0; nref < K; h++){
+      if(h != own0 && h != own1 && !used[h]){
+	used[h] = 1;
+	refs[nref++] = h;
+      }
+    }
+
+    ref.resize(W * K);
+    for(int k = 0; k < K; k++){
+      for(int l = 0; l < W; l++){
+	ref[l * K + k] = allele(refs[k], ws + l);
+      }
+    }
+
+    forward.resize(W * K * K);
+
+    for(int l = 0; l < W; l++){
+
+      const float  * L  = &lik[((ws + l) * nind + ind) * 3];
+      const double * rl = &ref[l * K];
+
+      // emission by the number of reference alternate alleles
+
+      double e0 = L[0] * (1 - e) * (1 - e) + L[1] * 2 * e * (1 - e)     + L[2] * e * e;
+      double e1 = L[0] * e * (1 - e)       + L[1] * ((1 - e) * (1 - e) + e * e) + L[2] * e * (1 - e);
+      double e2 = L[0] * e * e             + L[1] * 2 * e * (1 - e)     + L[2] * (1 - e) * (1 - e);
+
+      double * f    = &forward[l * K * K];
+      double * prev = l > 0 ? &forward[(l - 1) * K * K] : NULL;
+
+      if(prev){
+	for(int i = 0; i < K; i++){
+	  double sum = 0;
+	  for(int j = 0; j < K; j++){
+	    sum += prev[i * K + j];
+	  }
+	  rows[i] = sum;
+	}
+      }
+
+      double total = 0;
+
+      for(int i = 0; i < K; i++){
+
+	double lo = rl[i] ? e1 : e0;
+	double hi = rl[i] ? e2 : e1;
+
+	for(int j = 0; j < K; j++){
+	  erow[j] = lo + (hi - lo) * rl[j];
+	}
+
+	double * fi = &f[i * K];
+
+	if(prev){
+	  const double * pi = &prev[i * K];
+	  double ri = rows[i];
+	  for(int j = 0; j < K; j++){
+	    fi[j] = erow[j] * (A * pi[j] + B * (ri + rows[j]) + C);
+	  }
+	}
+	else{
+	  for(int j = 0; j < K; j++){
+	    fi[j] = erow[j] / KK;
+	  }
+	}
+	for(int j = 0; j < K; j++){
+	  total += fi[j];
+	}
+      }
+
+      double scale = 1 / total;
+      for(int s = 0; s < K * K; s++){
+	f[s] *= scale;
+      }
+    }
+
+    // backwards through the window: the previous state is weighted by its
+    // forward probability and the chance of switching into the current one
+
+    pathI.resize(W);
+    pathJ.resize(W);
+
+    int state = choose(&forward[(W - 1) * K * K], K * K, 1, sample, rng);
+    pathI[W - 1] = state / K;
+    pathJ[W - 1] = state % K;
+
+    for(int l = W - 2; l >= 0; l--){
+
+      const double * f = &forward[l * K * K];
+
+      int ci = pathI[l + 1];
+      int cj = pathJ[l + 1];
+
+      double total = 0;
+
+      for(int i = 0; i < K; i++){
+	double ti = (i == ci ? 1 - r : 0) + r / K;
+	for(int j = 0; j < K; j++){
+	  double tj = (j == cj ? 1 - r : 0) + r / K;
+	  weights[i * K + j] = f[i * K + j] * ti * tj;
+	  total += weights[i * K + j];
+	}
+      }
+
+      state = choose(&weights[0], K * K, total, sample, rng);
+      pathI[l] = state / K;
+      pathJ[l] = state % K;
+    }
+
+    // the alleles given the copied haplotypes and the likelihoods
+
+    a.resize(W);
+    b.resize(W);
+
+    for(int l = 0; l < W; l++){
+
+      const float * L = &lik[((ws + l) * nind + ind) * 3];
+
+      int ri = int(ref[l * K + pathI[l]]);
+      int rj = int(ref[l * K + pathJ[l]]);
+
+      double w[4];
+      for(int g = 0; g < 4; g++){
+	int x = g & 1;
+	int y = g >> 1;
+	w[g] = L[x + y] * (x == ri ? 1 - e : e) * (y == rj ? 1 - e : e);
+      }
+
+      int g = choose(w, 4, w[0] + w[1] + w[2] + w[3], sample, rng);
+      a[l] = g & 1;
+      b[l] = g >> 1;
+    }
+
+    // keep the orientation of the previous window across the overlap
+
+    int from = ws;
+
+    if(w0 > 0){
+
+      int overlap = min(PHASE_OVERLAP_WORDS * 64, W);
+      int agree = 0, disagree = 0;
+
+      for(int l = 0; l < overlap; l++){
+	if(a[l] == b[l]){
+	  continue;
+	}
+	int n0 = (next[own0 * nwords + ((ws + l) >> 6)] >> ((ws + l) & 63)) & 1;
+	agree    += (a[l] == n0);
+	disagree += (a[l] != n0);
+      }
+      if(disagree > agree){
+	a.swap(b);
+      }
+      from = ws + overlap / 2;
+    }
+
+    for(int s = from; s < we; s++){
+      setAllele(next, nwords, own0, s, a[s - ws]);
+      setAllele(next, nwords, own1, s, b[s - ws]);
+    }
+
+    if(w1 >= nwords){
+      break;
+    }
+  }
+}
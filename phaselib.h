@@ -0,0 +1,77 @@
+// Li and Stephens (2003) haplotype copying model for phasing, and filling
+// in missing calls, from genotype likelihoods.  Sites are buffered per
+// contig, then each individual is modelled as a mosaic of the current
+// haplotypes of the other individuals.  Only the closest haplotypes are
+// used as copying states, chosen separately for each window of sites.
+
+#ifndef __PHASELIB_H
+#define __PHASELIB_H
+
+#include <vector>
+#include "var.h"
+
+using namespace std;
+
+// windows are whole 64 site words so reference selection is a popcount;
+// consecutive windows share PHASE_OVERLAP_WORDS words to align their phase
+
+#define PHASE_WINDOW_WORDS  4
+#define PHASE_OVERLAP_WORDS 1
+#define PHASE_STATES        16
+#define PHASE_ITERATIONS    8
+#define PHASE_SWITCH        0.01
+#define PHASE_ERROR         0.01
+#define PHASE_GT_ERROR      0.001
+
+class lsPhaser{
+public:
+
+  // GT input carries no likelihoods, so calls are scored with PHASE_GT_ERROR
+
+  lsPhaser(int format);
+
+  void setStates(int k);
+  void setIterations(int n);
+  void setSeed(unsigned long long s);
+
+  // appends one site; pop must hold the same individuals, in the same
+  // order, at every site of the contig
+
+  void addSite(genotype * pop);
+  void phase(void);
+  void clear(void);
+
+  int nsites(void);
+  int nhaplotypes(void);
+
+  // haplotypes 2i and 2i+1 belong to the i-th individual given to addSite
+
+  inline int allele(int hap, int site){
+    return (haps[hap * nwords + (site >> 6)] >> (site & 63)) & 1;
+  }
+
+private:
+
+  bool calls;
+  int  states;
+  int  iterations;
+  unsigned long long seed;
+
+  int nind;
+  int nsite;
+  int nwords;
+
+  // three genotype likelihoods (aa, ab, bb) per individual, site major
+
+  vector<float> lik;
+
+  // bit packed haplotypes, one run of nwords per haplotype
+
+  vector<unsigned long long> haps;
+
+  void initialise(void);
+  bool duplicate(int h, vector<int> & refs, int nref, int w0, int w1);
+  void phaseIndividual(int ind, int iteration, vector<unsigned long long> & next);
+};
+
+#endif
@@ -31,6 +31,7 @@ void printHelp(void){
 
   cerr << "INFO: plotHaps  --target 0,1,2,3,4,5,6,7  --file my.phased.vcf.gz                                                           " << endl << endl;
   cerr << "INFO: required: t,target     -- argument: a zero base comma separated list of target individuals corrisponding to VCF column s        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: r,region     -- argument: a tabix compliant genomic range : \"seqid:start-end\" or \"seqid\"                          " << endl;
   cerr << "INFO: required: f,file       -- argument: proper formatted phased VCF file                                                            " << endl;
   cerr << "INFO: required: y,type       -- argument: genotype likelihood format: PL,GP,GP                                                        " << endl;
@@ -140,14 +141,14 @@ double EHH(string haplotypes[][2], int nhaps){
 }
 
 void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
+
+  // missing calls carry the reference allele
+
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    haplotypes[indIndex][0] += char('0' + gtFirst(*ind));
+    haplotypes[indIndex][1] += char('0' + gtSecond(*ind));
     indIndex += 1;
   }
 }
@@ -184,6 +185,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file
+
+  vector<string> targetNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -204,6 +209,7 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
 	{0,0,0,0}
@@ -214,7 +220,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:t:f:hv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "y:r:t:f:hvT:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -225,6 +231,10 @@ int main(int argc, char** argv) {
 	  case 'y':
 	    type = optarg;
 	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -261,6 +271,8 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     if(filename == "NA"){
       cerr << "FATAL: did not specify a file" << endl;
       printHelp();
@@ -292,6 +304,8 @@ int main(int argc, char** argv) {
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+
     vector<int> target_h, background_h;
 
     int index  = 0;
@@ -299,7 +313,7 @@ int main(int argc, char** argv) {
 
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
      
-      if(it.find(index) != it.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
@@ -315,6 +329,12 @@ int main(int argc, char** argv) {
     string currentSeqid = "NA";
     
    
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
 
       if(!var.isPhased()){
@@ -327,43 +347,34 @@ int main(int argc, char** argv) {
       }
 
       
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
 
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
       
-	if(it.find(sindex) != it.end() ){
-	  target.push_back(sample);
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
 	}	
 	sindex += 1;
       }
       
-      genotype * populationTarget    ;
-
-      if(type == "PL"){
-	populationTarget     = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-      }
-      if(type == "GT"){
-	populationTarget     = new gt();
-      }
+      populationTarget->reset();
       
       populationTarget->loadPop(target, var.sequenceName, var.position);
       
       positions.push_back(var.position);
       afs.push_back(populationTarget->af);
-      loadPhased(haplotypes, populationTarget, populationTarget->gts.size()); 
+      loadPhased(haplotypes, populationTarget, populationTarget->gtCodes.size()); 
     }
     
     printHaplotypes( haplotypes, target_h, positions);
     
+    delete populationTarget;
+
     return 0;		    
 }
@@ -42,6 +42,7 @@ void printHelp(void){
   cerr << "INFO: usage:  popStat --type PL --target 0,1,2,3,4,5,6,7 --file my.vcf                                                                " << endl;
   cerr << endl;
   cerr << "INFO: required: t,target     -- a zero based comma seperated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: f,file       -- proper formatted VCF                                                                        " << endl;
   cerr << "INFO: required, y,type       -- genotype likelihood format; genotype : GL,PL,GP                                             " << endl;
   cerr << "INFO: optional, r,region     -- a tabix compliant region : chr1:1-1000 or chr1                                              " << endl;
@@ -93,6 +94,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file
+
+  vector<string> targetNames;
   
   // genotype likelihood format
 
@@ -104,6 +109,7 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
 	{0,0,0,0}
@@ -114,7 +120,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:chv", longopts, &index);
+	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:chvT:", longopts, &index);
 	
 	switch (iarg)
 	  {
@@ -124,6 +130,10 @@ int main(int argc, char** argv) {
 	  case 'v':
 	    printVersion();
 	    return 0;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -192,11 +202,21 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     Variant var(variantFile);
 
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
         
 	// biallelic sites naturally 
@@ -205,37 +225,25 @@ int main(int argc, char** argv) {
 	  continue;
 	}
 	
-	vector < map< string, vector<string> > > target, background, total;
+	target.clear();
+	background.clear();
+	total.clear();
 	        
 	int index = 0;
 
 	for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	  map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	  map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 
 	    if(sample["GT"].front() != "./."){
-	      if(it.find(index) != it.end() ){
-		target.push_back(sample);
+	      if(targetMember[index]){
+		target.push_back(&sample);
 	      }
 	    }            
 	    index += 1;
 	}
 	
-	genotype * populationTarget      ;
-	genotype * populationBackground  ;
-
-	if(type == "PL"){
-	  populationTarget     = new pl();
-	}
-	if(type == "GL"){
-	  populationTarget     = new gl();
-	}
-	if(type == "GP"){
-	  populationTarget     = new gp();
-	}
-	if(type == "GT"){
-          populationTarget     = new gt();
-	}
+	populationTarget->reset();
 	
 	populationTarget->loadPop(target, var.sequenceName, var.position);
 
@@ -263,5 +271,8 @@ int main(int argc, char** argv) {
 	     << populationTarget->fis   << endl;
 
     }
+
+    delete populationTarget;
+
     return 0;		    
 }
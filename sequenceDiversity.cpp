@@ -5,6 +5,7 @@
 #include "var.h"
 
 #include <string>
+#include <algorithm>
 #include <iostream>
 #include <math.h>  
 #include <cmath>
@@ -41,6 +42,7 @@ void printHelp(void){
   cerr << "INFO: usage: sequenceDiversity --target 0,1,2,3,4,5,6,7 --file my.vcf                                                                      " << endl;
   cerr << endl;
   cerr << "INFO: required: t,target     -- argument: a zero base comma separated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: f,file       -- argument: a properly formatted phased VCF file                                                       " << endl;
   cerr << "INFO: required: y,type       -- argument: type of genotype likelihood: PL, GL or GP                                                  " << endl;
   cerr << "INFO: optional: a,af         -- sites less than af  are filtered out; default is 0                                          " << endl;      
@@ -142,14 +144,14 @@ void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<double
 }
 
 void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
+
+  // missing calls carry the reference allele
+
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    haplotypes[indIndex][0] += char('0' + gtFirst(*ind));
+    haplotypes[indIndex][1] += char('0' + gtSecond(*ind));
     indIndex += 1;
   }
 }
@@ -175,6 +177,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> targetIndex, backgroundIndex;
+
+  // sample names from --target-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -208,6 +214,7 @@ int main(int argc, char** argv) {
 	{"help"        , 0, 0, 'h'},
         {"file"        , 1, 0, 'f'},
 	{"target"      , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"region"      , 1, 0, 'r'},
 	{"type"        , 1, 0, 'y'},
 	{"window"      , 1, 0, 'w'},
@@ -222,7 +229,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "w:y:r:t:b:f:edhv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "w:y:r:t:b:f:edhvT:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -245,6 +252,12 @@ int main(int argc, char** argv) {
 	      cerr << "INFO: filtering out allele frequencies less than: " << af_filt << endl;
 	      break;
 	    }
+	  case 'T':
+	    {
+	      loadSampleFile(optarg, targetNames);
+	      cerr << "INFO: target sample file: " << optarg << endl;
+	      break;
+	    }
 	  case 't':
 	    {
 	      loadIndices(targetIndex, optarg);
@@ -293,13 +306,6 @@ int main(int argc, char** argv) {
     okayGenotypeLikelihoods["GP"] = 1;
     okayGenotypeLikelihoods["GT"] = 1;
 
-    if(targetIndex.size() < 2){
-      cerr << endl;
-      cerr << "FATAL: failed to specify a target - or - too few individuals in the target" << endl;
-      printHelp();
-      return 1;
-    }
-
     if(type == "NA"){
       cerr << "FATAL: failed to specify genotype likelihood format : PL or GL" << endl;
       printHelp();
@@ -311,6 +317,8 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     if(filename == "NA"){
       cerr << "FATAL: did not specify a file" << endl;
       printHelp();
@@ -334,17 +342,27 @@ int main(int argc, char** argv) {
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, targetIndex, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, backgroundIndex, backgroundNames, "background");
+
+    if(count(targetMember.begin(), targetMember.end(), 1) < 2){
+      cerr << endl;
+      cerr << "FATAL: failed to specify a target - or - too few individuals in the target" << endl;
+      printHelp();
+      return 1;
+    }
+
     vector<int> target_h, background_h;
 
-    int index, indexi = 0;
+    int index = 0, indexi = 0;
    
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
       string sampleName = (*samp);
-      if(targetIndex.find(index) != targetIndex.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
-      if(backgroundIndex.find(index) != backgroundIndex.end()){
+      if(backgroundMember[index]){
 	background_h.push_back(indexi);
 	indexi++;
       }
@@ -359,6 +377,14 @@ int main(int argc, char** argv) {
     
     string currentSeqid = "NA";
     
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget     = newGenotype(format);
+    genotype * populationBackground = newGenotype(format);
+    genotype * populationTotal      = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
 
       if(!var.isPhased()){
@@ -381,49 +407,30 @@ int main(int argc, char** argv) {
       }
 
       
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
       
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 
-	if(targetIndex.find(sindex) != targetIndex.end() ){
-	  target.push_back(sample);
-	  total.push_back(sample);	  
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
-	if(backgroundIndex.find(sindex) != backgroundIndex.end()){
-	  background.push_back(sample);
-	  total.push_back(sample);	  
+	if(backgroundMember[sindex]){
+	  background.push_back(&sample);
+	  total.push_back(&sample);	  
 	}	
 	sindex += 1;
       }
       
-      genotype * populationTarget    ;
-      genotype * populationBackground;
-      genotype * populationTotal     ;
-      
-      if(type == "PL"){
-	populationTarget     = new pl();
-	populationBackground = new pl();
-	populationTotal      = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-	populationBackground = new gl();
-	populationTotal      = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-	populationBackground = new gp();
-	populationTotal      = new gp();
-      }
-      if(type == "GT"){
-        populationTarget     = new gt();
-        populationBackground = new gt();
-        populationTotal      = new gt();
-      }
+      populationTarget->reset();
+      populationBackground->reset();
+      populationTotal->reset();
       
       populationTarget->loadPop(target,         var.sequenceName, var.position);
       
@@ -432,10 +439,6 @@ int main(int argc, char** argv) {
       populationTotal->loadPop(total,           var.sequenceName, var.position);
 
       if(populationTotal->af < af_filt){
-	
-	delete populationTarget;
-	delete populationBackground;
-	delete populationTotal;
 	continue;
       }
       
@@ -448,5 +451,9 @@ int main(int argc, char** argv) {
 
     calc(haplotypes, nsamples, positions, targetAFS, backgroundAFS, external, derived, windowSize, target_h, background_h, currentSeqid);
     
+    delete populationTarget;
+    delete populationBackground;
+    delete populationTotal;
+
     return 0;		    
 }
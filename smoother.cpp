@@ -1,13 +1,20 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <getopt.h>
 #include <map>
-#include <list>
+#include <set>
+#include <cmath>
 #include <vector>
 #include <string>
 #include "split.h"
 #include <stdio.h> 
 #include <stdlib.h>
+#include <zlib.h>
+
+#ifdef HAS_OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -18,8 +25,15 @@ struct opts{
   int      seqid;
   int      pos  ; 
   int      value;
+  long int batch;
+  int      mode;
+  double   fraction;
 };
 
+// window summaries
+
+enum windowMode { MODE_MEAN, MODE_MEDIAN, MODE_QUANTILE, MODE_TRIMMED, MODE_MAXABS };
+
 struct score{
   long int position;
   double score;
@@ -45,103 +59,362 @@ void printHelp(void){
   cerr << "     1. seqid            "    << endl;
   cerr << "     2. window start     "    << endl;
   cerr << "     2. window end       "    << endl;
-  cerr << "     3. averaged score   "    << endl  << endl;
+  cerr << "     3. number of scores "    << endl;
+  cerr << "     4. window summary   "    << endl  << endl;
 
   cerr << "INFO: usage: smoother --format pFst --file GPA.output.txt" << endl;
   cerr << endl;
-  cerr << "INFO: required: f,file     -- argument: a file created by GPAT++                           " << endl;
+  cerr << "INFO: required: f,file     -- argument: a file created by GPAT++, plain or bgzip; - for stdin" << endl;
   cerr << "INFO: required: o,format   -- argument: format of input file, case sensative               " << endl;
   cerr << "                              availible format options:                                    " << endl;
   cerr << "                                wcFst, pFst, bFst, iHS, xpEHH, abba-baba                   " << endl;
   cerr << "INFO: optional: w,window   -- argument: size of genomic window in base pairs (default 5000)" << endl;
   cerr << "INFO: optional: s,step     -- argument: window step size in base pairs (default 1000)      " << endl;
+  cerr << "INFO: optional: m,mode     -- argument: window summary: mean, median, quantile, trimmed, maxabs (default mean)" << endl;
+  cerr << "                              maxabs reports the score furthest from zero, keeping its sign        " << endl;
+  cerr << "INFO: optional: q,fraction -- argument: the quantile, or the fraction trimmed from each end (default 0.5 ; 0.1)" << endl;
+  cerr << "INFO: optional: b,batch    -- argument: scores buffered before seqids are smoothed in parallel (default 1000000)" << endl;
+  cerr << "INFO: optional: t,threads  -- argument: number of threads, requires make openmp (default 1)  " << endl;
   printVersion();
   cerr << endl << endl;
 }
 
-double windowAvg(list<score> & rangeData){
+// The order statistics of the window.  The scores are split into three
+// sorted multisets, low <= mid <= high, whose sizes are rebalanced on
+// every insert and erase; a quantile is read at the low/mid boundary and
+// a trimmed mean from the running sum of mid.  Updates are O(log n).
+
+class orderWindow{
+private:
+  multiset<double> low;
+  multiset<double> mid;
+  multiset<double> high;
+  double           midSum;
+  int              mode;
+  double           fraction;
+
+  void toMid(multiset<double> & from, multiset<double>::iterator it){
+    midSum += *it;
+    mid.insert(*it);
+    from.erase(it);
+  }
+  void fromMid(multiset<double> & to, multiset<double>::iterator it){
+    midSum -= *it;
+    to.insert(*it);
+    mid.erase(it);
+  }
+  long int size(void){
+    return low.size() + mid.size() + high.size();
+  }
+  void targets(long int & nLow, long int & nHigh){
+    long int n = size();
+    nLow  = 0;
+    nHigh = 0;
+    if(n == 0){
+      return;
+    }
+    if(mode == MODE_MEDIAN || mode == MODE_QUANTILE){
+      nLow = (long int)floor((n - 1) * fraction) + 1;
+    }
+    if(mode == MODE_TRIMMED){
+      nLow  = (long int)floor(n * fraction);
+      nHigh = nLow;
+    }
+  }
+  void rebalance(void){
+    long int nLow, nHigh;
+    targets(nLow, nHigh);
 
-  double n = 0;
-  double s = 0;
+    while((long int)low.size() > nLow){
+      toMid(low, --low.end());
+    }
+    while((long int)high.size() > nHigh){
+      toMid(high, high.begin());
+    }
+    while((long int)low.size() < nLow){
+      fromMid(low, mid.begin());
+    }
+    while((long int)high.size() < nHigh){
+      fromMid(high, --mid.end());
+    }
+    if(mid.empty()){
+      midSum = 0;
+    }
+  }
 
-  for(list<score>::iterator it = rangeData.begin(); it != rangeData.end(); it++){
-    s += it->score;
-    n += 1;
+public:
+  orderWindow(int mode = MODE_MEAN, double fraction = 0.5) : midSum(0), mode(mode), fraction(fraction){}
+
+  bool active(void){
+    return mode != MODE_MEAN;
   }
-  return (s/n);
-}
+  // non-finite scores (nan from iHS or Fst output) have no place in the
+  // ordering, so they are skipped on the way in and on the way out
 
-//calculation of Patterson's D statistic
-double dStatistic(list<score> & rangeData){
+  void insert(double value){
+    if(!std::isfinite(value)){
+      return;
+    }
+    if(!low.empty() && value <= *low.rbegin()){
+      low.insert(value);
+    }
+    else if(!high.empty() && value >= *high.begin()){
+      high.insert(value);
+    }
+    else{
+      midSum += value;
+      mid.insert(value);
+    }
+    rebalance();
+  }
+  void erase(double value){
+    if(!std::isfinite(value)){
+      return;
+    }
+    if(!low.empty() && value <= *low.rbegin()){
+      low.erase(low.find(value));
+    }
+    else if(!high.empty() && value >= *high.begin()){
+      high.erase(high.find(value));
+    }
+    else{
+      midSum -= value;
+      mid.erase(mid.find(value));
+    }
+    rebalance();
+  }
+  double report(void){
+    long int n = size();
+    if(n == 0){
+      return nan("");
+    }
+    if(mode == MODE_TRIMMED){
+      return midSum / mid.size();
+    }
+    if(mode == MODE_MAXABS){
+      double least = *mid.begin();
+      double most  = *mid.rbegin();
+      return fabs(least) > fabs(most) ? least : most;
+    }
+    // linear interpolation between the order statistics around the quantile
+    double h    = (n - 1) * fraction;
+    double part = h - floor(h);
+    double x    = *low.rbegin();
+    if(part > 0 && !mid.empty()){
+      x += part * (*mid.begin() - x);
+    }
+    return x;
+  }
+};
+
+// The scores in the current window, oldest first.  They live in a ring
+// buffer that grows by doubling, and the sums the reports need are kept
+// up to date on every push and pop, so a window costs O(1) amortised
+// rather than a rescan of its contents.
+
+class scoreWindow{
+private:
+  vector<score> ring;
+  long int      head;
+  long int      count;
 
-  double abba = 0;
-  double baba = 0;
-  double dstat ;
-  for(list<score>::iterator it = rangeData.begin(); it != rangeData.end(); it++){
-    if(it->score == 0){ // means we have BABA locus
+public:
+  double      sum;
+  long int    nonfinite;
+  double      abba;
+  double      baba;
+  orderWindow order;
+
+  scoreWindow(int mode = MODE_MEAN, double fraction = 0.5) : ring(16), head(0), count(0), sum(0), nonfinite(0), abba(0), baba(0), order(mode, fraction){}
+
+  long int size(void){
+    return count;
+  }
+  bool empty(void){
+    return count == 0;
+  }
+  score & front(void){
+    return ring[head];
+  }
+  void push_back(score & current){
+    if(count == (long int)ring.size()){
+      vector<score> grown(ring.size() * 2);
+      for(long int i = 0; i < count; i++){
+	grown[i] = ring[(head + i) % ring.size()];
+      }
+      ring.swap(grown);
+      head = 0;
+    }
+    ring[(head + count) % ring.size()] = current;
+    count += 1;
+
+    // a nan or inf would stay in the running sum after it left the
+    // window, so non-finite scores are counted instead
+
+    if(std::isfinite(current.score)){
+      sum += current.score;
+    }
+    else{
+      nonfinite += 1;
+    }
+    if(order.active()){
+      order.insert(current.score);
+    }
+    if(current.score == 0){ // means we have BABA locus
       baba += 1;
     }
     else{ // count towards ABBA locus
       abba += 1;
     }
   }
-  dstat = (abba - baba) / (abba + baba ); // d-statistic implementation
+  void pop_front(void){
+    score & old = ring[head];
+
+    if(std::isfinite(old.score)){
+      sum -= old.score;
+    }
+    else{
+      nonfinite -= 1;
+    }
+    if(order.active()){
+      order.erase(old.score);
+    }
+    if(old.score == 0){
+      baba -= 1;
+    }
+    else{
+      abba -= 1;
+    }
+    head   = (head + 1) % ring.size();
+    count -= 1;
+
+    // an empty window drops any rounding left in the running sum
+    if(count == 0){
+      sum = 0;
+    }
+  }
+};
+
+// nan while the window holds a non-finite score, as a rescan would give
+
+double windowAvg(scoreWindow & rangeData){
+  if(rangeData.nonfinite > 0){
+    return nan("");
+  }
+  return (rangeData.sum / rangeData.size());
+}
+
+//calculation of Patterson's D statistic
+double dStatistic(scoreWindow & rangeData){
+  double dstat = (rangeData.abba - rangeData.baba) / (rangeData.abba + rangeData.baba ); // d-statistic implementation
   return (dstat);
 }
 
-void processSeqid(ifstream & file, string seqid, streampos offset, opts & opt){
-    
-  string line ;
-  
-  long int windowSize = opt.size;
-  long int start = 0;
-  long int end   = windowSize;
+double windowReport(scoreWindow & rangeData, opts & opt){
+  if(opt.format == "abba-baba"){
+    return dStatistic(rangeData);
+  }
+  if(rangeData.order.active()){
+    return rangeData.order.report();
+  }
+  return windowAvg(rangeData);
+}
 
-  list<score> windowDat;
+// the sliding window of one seqid
 
-  file.clear();
-    
-  file.seekg(offset);
-  
-  vector<string> sline;
+struct seqidState{
+  ostream *   out;
+  string      seqid;
+  long int    start;
+  long int    end;
+  scoreWindow windowDat;
+};
 
-  while(getline(file, line)){
-    
-    sline = split(line, '\t');     
-    score current ;
-    if(seqid != sline[opt.seqid]){
-      break;
+void startSeqid(seqidState & state, string & seqid, opts & opt, ostream & out){
+  state.out       = &out;
+  state.seqid     = seqid;
+  state.start     = 0;
+  state.end       = opt.size;
+  state.windowDat = scoreWindow(opt.mode, opt.fraction);
+}
+
+void addScore(seqidState & state, score & current, opts & opt){
+
+  scoreWindow & windowDat = state.windowDat;
+
+  if(current.position > state.end){
+
+    double reportValue = windowReport(windowDat, opt);
+
+    *(state.out) << state.seqid << "\t" << state.start << "\t" << state.end << "\t" << windowDat.size() << "\t" << reportValue << endl;
+  }
+  while(state.end < current.position){
+    state.start += opt.step;
+    state.end   += opt.step;
+    while(!windowDat.empty() && windowDat.front().position < state.start){
+      windowDat.pop_front();
     }
-    current.position = atol( sline[opt.pos].c_str() );
-    current.score    = atof( sline[opt.value].c_str() );
-    // add in if abba-baba to process second score. 
-    if(current.position > end){
+  }
+  windowDat.push_back(current);  
+}
 
-      double reportValue ;
+void finishSeqid(seqidState & state, opts & opt){
+  double reportValue = windowReport(state.windowDat, opt);
+  *(state.out) << state.seqid << "\t" << state.start << "\t" << state.end << "\t" << state.windowDat.size() << "\t" << reportValue << endl;
+}
 
+// the buffered scores of one seqid
 
-      if(opt. format == "abba-baba"){
-	reportValue = dStatistic(windowDat);
-      }
-      else{
-	reportValue = windowAvg(windowDat);
-      }
+struct pendingSeqid{
+  string        seqid;
+  vector<score> scores;
+};
+
+// Seqids are buffered until a batch of scores has been read.  The
+// completed seqids of the batch are smoothed concurrently, each into its
+// own buffer, and written in input order.
 
-      cout << seqid << "\t" << start << "\t" << end << "\t" << windowDat.size() << "\t" << reportValue << endl;
+void smoothPending(vector<pendingSeqid> & pending, long int n, opts & opt){
+
+  vector<string> results(n);
+
+#ifdef HAS_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(long int i = 0; i < n; i++){
+    ostringstream out;
+    seqidState state;
+    startSeqid(state, pending[i].seqid, opt, out);
+    for(vector<score>::iterator it = pending[i].scores.begin(); it != pending[i].scores.end(); it++){
+      addScore(state, *it, opt);
     }
-    while(end < current.position){
-      start += opt.step;
-      end   += opt.step;
-      while(windowDat.front().position < start && !windowDat.empty()){
-	windowDat.pop_front();
-      }
+    finishSeqid(state, opt);
+    results[i] = out.str();
+  }
+
+  for(long int i = 0; i < n; i++){
+    cerr << "INFO: processing seqid : " << pending[i].seqid << endl;
+    cout << results[i];
+    cerr << "INFO: smoother finished : " << pending[i].seqid << endl;
+  }
+  pending.erase(pending.begin(), pending.begin() + n);
+}
+
+// reads one line from a plain or gzip/bgzip stream, without the newline
+
+bool getGzLine(gzFile fh, string & line){
+  char buffer[4096];
+
+  line.clear();
+
+  while(gzgets(fh, buffer, sizeof(buffer)) != NULL){
+    line += buffer;
+    if(line[line.size() - 1] == '\n'){
+      line.erase(line.size() - 1);
+      return true;
     }
-    windowDat.push_back(current);  
   }
-  // add function for D-stat if abba-baba
-  double finalMean = windowAvg(windowDat);
-  cout << seqid << "\t" << start << "\t" << end << "\t" << windowDat.size() << "\t" << finalMean << endl;
-  cerr << "INFO: smoother finished : " << seqid << endl;
+  return !line.empty();
 }
 
 int main(int argc, char** argv) {
@@ -160,6 +433,11 @@ int main(int argc, char** argv) {
   opts opt;
   opt.size = 5000;
   opt.step = 1000;
+  opt.batch = 1000000;
+  opt.mode  = MODE_MEAN;
+  opt.fraction = -1;
+
+  string mode = "mean";
   opt.format = "NA";
 
   string filename = "NA";
@@ -172,6 +450,10 @@ int main(int argc, char** argv) {
       {"window"    , 1, 0, 'w'},
       {"step"      , 1, 0, 's'},
       {"format"    , 1, 0, 'o'},
+      {"batch"     , 1, 0, 'b'},
+      {"mode"      , 1, 0, 'm'},
+      {"fraction"  , 1, 0, 'q'},
+      {"threads"   , 1, 0, 't'},
       {0,0,0,0}
     };
 
@@ -179,7 +461,7 @@ int main(int argc, char** argv) {
   int iarg=0;
 
   while(iarg != -1){
-    iarg = getopt_long(argc, argv, "f:w:s:o:vh", longopts, &index);
+    iarg = getopt_long(argc, argv, "f:w:s:o:b:t:m:q:vh", longopts, &index);
     switch(iarg){
     case 'h':
       printHelp();
@@ -203,6 +485,26 @@ int main(int argc, char** argv) {
       opt.format = optarg;
       cerr << "INFO: specified input format : " << optarg << endl;
       break;
+    case 'm':
+      mode = optarg;
+      cerr << "INFO: window summary : " << optarg << endl;
+      break;
+    case 'q':
+      opt.fraction = atof(optarg);
+      cerr << "INFO: fraction : " << optarg << endl;
+      break;
+    case 'b':
+      opt.batch = atol(optarg);
+      cerr << "INFO: batch size : " << optarg << endl;
+      break;
+    case 't':
+#ifdef HAS_OPENMP
+      omp_set_num_threads(atoi(optarg));
+      cerr << "INFO: threads : " << optarg << endl;
+#else
+      cerr << "WARNING: smoother was built without openmp, ignoring threads : " << optarg << endl;
+#endif
+      break;
     }
   }
   if(filename == "NA"){
@@ -211,6 +513,46 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if(mode == "mean"){
+    opt.mode = MODE_MEAN;
+  }
+  else if(mode == "median"){
+    opt.mode     = MODE_MEDIAN;
+    opt.fraction = 0.5;
+  }
+  else if(mode == "quantile"){
+    opt.mode = MODE_QUANTILE;
+    if(opt.fraction < 0){
+      opt.fraction = 0.5;
+    }
+  }
+  else if(mode == "trimmed"){
+    opt.mode = MODE_TRIMMED;
+    if(opt.fraction < 0){
+      opt.fraction = 0.1;
+    }
+  }
+  else if(mode == "maxabs"){
+    opt.mode = MODE_MAXABS;
+  }
+  else{
+    cerr << "FATAL: unknown window summary : " << mode << endl << endl;
+    printHelp();
+    return 1;
+  }
+  if(opt.mode == MODE_QUANTILE && (opt.fraction < 0 || opt.fraction > 1)){
+    cerr << "FATAL: the quantile must be between zero and one" << endl;
+    return 1;
+  }
+  if(opt.mode == MODE_TRIMMED && opt.fraction >= 0.5){
+    cerr << "FATAL: the trimmed fraction must be below one half" << endl;
+    return 1;
+  }
+  if(opt.format == "abba-baba" && opt.mode != MODE_MEAN){
+    cerr << "FATAL: abba-baba windows always report Patterson's D" << endl;
+    return 1;
+  }
+
   if(acceptableFormats.find(opt.format) == acceptableFormats.end()){
     cerr << "FATAL: unacceptable input file format, see --format "  << endl << endl;
     printHelp();
@@ -263,43 +605,110 @@ int main(int argc, char** argv) {
     return 1;
   }
   
-  ifstream ifs(filename.c_str());
- 
-  string currentSeqid = "NA";
+  // zlib reads plain text, gzip and bgzip alike; "-" is stdin
+
+  gzFile ifs;
+
+  if(filename == "-"){
+    ifs = gzdopen(fileno(stdin), "r");
+  }
+  else{
+    ifs = gzopen(filename.c_str(), "r");
+  }
+
+  if(ifs == NULL){
+    cerr << "FATAL: couldn't open file : " << filename << endl;
+    return 1;
+  }
+
+  unsigned int maxColumn = max(opt.seqid, max(opt.pos, opt.value));
+
+  map<string, int> seen;
+
+  // a seqid with more than a batch of scores is smoothed as it streams in
+
+  vector<pendingSeqid> pending;
+  long int pendingScores = 0;
+
+  seqidState state;
 
   string line;
 
-  map<string, streampos > seqidIndex;
-  
-  if(ifs){
-    while(getline(ifs, line)){
-      vector<string> sline = split(line, '\t');
-      if(sline[opt.seqid] != currentSeqid){
-	
-	int bline = ifs.tellg() ;
-	//	bline -=  - ( line.size() +1 );
-	
-	map<string, streampos>::iterator it;
-
-	if(seqidIndex.find(sline[opt.seqid]) != seqidIndex.end() ){
-	  cerr << "FATAL: file is unsorted!" << endl;
-	  return 1;
-	}
-	seqidIndex[sline[opt.seqid]] = bline;
-	currentSeqid = sline[opt.seqid];
+  bool streaming = false;
+
+  while(getGzLine(ifs, line)){
+
+    if(line.empty()){
+      continue;
+    }
+
+    vector<string> sline = split(line, '\t');
+
+    if(sline.size() <= maxColumn){
+      cerr << "FATAL: too few columns for format " << opt.format << " : " << line << endl;
+      return 1;
+    }
+
+    score current ;
+    current.position = atol( sline[opt.pos].c_str() );
+    current.score    = atof( sline[opt.value].c_str() );
+
+    if(streaming){
+      if(sline[opt.seqid] == state.seqid){
+	addScore(state, current, opt);
+	continue;
+      }
+      finishSeqid(state, opt);
+      cerr << "INFO: smoother finished : " << state.seqid << endl;
+      streaming = false;
+    }
+
+    if(pending.empty() || sline[opt.seqid] != pending.back().seqid){
+      if(seen.find(sline[opt.seqid]) != seen.end()){
+	cerr << "FATAL: file is unsorted!" << endl;
+	return 1;
+      }
+      seen[sline[opt.seqid]] = 1;
+      pending.push_back(pendingSeqid());
+      pending.back().seqid = sline[opt.seqid];
+    }
+
+    pending.back().scores.push_back(current);
+    pendingScores += 1;
+
+    if(pendingScores < opt.batch){
+      continue;
+    }
+
+    // the last seqid may still be reading
+
+    smoothPending(pending, pending.size() - 1, opt);
+    pendingScores = pending.back().scores.size();
+
+    if(pendingScores >= opt.batch){
+      cerr << "INFO: processing seqid : "<< pending.back().seqid << endl;
+      startSeqid(state, pending.back().seqid, opt, cout);
+      for(vector<score>::iterator it = pending.back().scores.begin(); it != pending.back().scores.end(); it++){
+	addScore(state, *it, opt);
       }
+      pending.clear();
+      pendingScores = 0;
+      streaming     = true;
     }
   }
-  else{
-    cerr << "FATAL: no lines -- or -- couldn't open file" << endl;
+
+  if(streaming){
+    finishSeqid(state, opt);
+    cerr << "INFO: smoother finished : " << state.seqid << endl;
   }
+  smoothPending(pending, pending.size(), opt);
 
-  for( map< string, streampos>::iterator it = seqidIndex.begin(); it != seqidIndex.end(); it++){
-    cerr << "INFO: processing seqid : "<< (it->first) << endl;
-    processSeqid(ifs, (it->first),(it->second), opt);
+  if(seen.empty()){
+    cerr << "FATAL: no lines -- or -- couldn't open file" << endl;
   }
-  
-  ifs.close();
+
+  gzclose(ifs);
+
   cerr << "INFO: smoother has successfully finished" << endl;
 
   return 0;
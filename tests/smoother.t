@@ -0,0 +1,26 @@
+#!/usr/bin/env perl
+# smoother: a non-finite score only affects the windows that hold it
+
+use strict;
+use warnings;
+use File::Temp qw(tempfile);
+use Test::More tests => 4;
+
+my $smoother = $ENV{SMOOTHER} || '../bin/smoother';
+
+# a dense pFst file with a nan at position 500
+
+my ($fh, $input) = tempfile(SUFFIX => '.txt', UNLINK => 1);
+for(my $pos = 100; $pos <= 20000; $pos += 100){
+    print $fh join("\t", 'chr1', $pos, $pos == 500 ? 'nan' : '0.5'), "\n";
+}
+close($fh);
+
+my @windows = map { chomp; [split /\t/] } `$smoother -f $input -w 5000 -s 1000 -o pFst 2>/dev/null`;
+
+is($?, 0, 'smoother exits cleanly');
+is($windows[0][4], 'nan', 'the window holding the nan is nan');
+
+my @later = grep { $_->[1] >= 1000 } @windows;
+ok(scalar(@later) > 0, 'later windows are reported');
+is(scalar(grep { $_->[4] ne '0.5' } @later), 0, 'windows past the nan average 0.5');
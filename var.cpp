@@ -1,81 +1,131 @@
 #include "var.h"
+#include <fstream>
 
-genotype::~genotype(){}
+// PL values are almost always small integers, so the natural log
+// likelihoods are precomputed: log(10^(-PL/10)) == -PL * ln(10) / 10
 
-zvar::~zvar(){}
+#define PL_TABLE_SIZE 2048
 
-void zvar::setPopName(string  popName){
-  name = popName;
+static double plTable[PL_TABLE_SIZE];
+
+static bool initPlTable(void){
+  for(int i = 0; i < PL_TABLE_SIZE; i++){
+    plTable[i] = -double(i) * (M_LN10 / 10);
+  }
+  return true;
 }
 
-pooled::~pooled(){}
+static bool plTableLoaded = initPlTable();
 
-double pooled::bound(double v){
-  if(v <= 0.00001){
-    return  0.00001;
+static const double powersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,
+                                     1e7,  1e8,  1e9,  1e10, 1e11, 1e12, 1e13,
+                                     1e14, 1e15, 1e16, 1e17, 1e18};
+
+double fastAtof(const char * s){
+
+  const char * start = s;
+
+  double sign = 1;
+
+  if(*s == '-'){
+    sign = -1;
+    s++;
   }
-  if(v >= 0.99999){
-    return 0.99999;
+  else if(*s == '+'){
+    s++;
   }
-  return v;
-}
 
-gl::~gl(){}
+  unsigned long long mantissa = 0;
+  int ndigits  = 0;
+  int exponent = 0;
 
-gl::gl(void){
-  nalt  = 0;
-  nref  = 0;
-  af    = 0;
-  nhomr = 0;
-  nhoma = 0;
-  nhet  = 0;
-  ngeno = 0;
-  fis   = 0;
-  hfrq  = 0;
+  while(*s >= '0' && *s <= '9'){
+    if(ndigits < 18){
+      mantissa = mantissa * 10 + (*s - '0');
+      ndigits++;
+    }
+    else{
+      exponent++;
+    }
+    s++;
+  }
+  if(*s == '.'){
+    s++;
+    while(*s >= '0' && *s <= '9'){
+      if(ndigits < 18){
+	mantissa = mantissa * 10 + (*s - '0');
+	ndigits++;
+	exponent--;
+      }
+      s++;
+    }
+  }
+  if(*s == 'e' || *s == 'E'){
+    s++;
+    int esign = 1;
+    if(*s == '-'){
+      esign = -1;
+      s++;
+    }
+    else if(*s == '+'){
+      s++;
+    }
+    int e = 0;
+    while(*s >= '0' && *s <= '9'){
+      e = e * 10 + (*s - '0');
+      s++;
+    }
+    exponent += esign * e;
+  }
+
+  // inf, nan and anything else odd go through the C library
+
+  if(*s != '\0'){
+    return atof(start);
+  }
+
+  double value = double(mantissa);
 
-  alpha = 0.01;
-  beta  = 0.01;
+  if(exponent < 0){
+    if(exponent < -18){
+      return sign * value * pow(10, exponent);
+    }
+    return sign * value / powersOfTen[-exponent];
+  }
+  if(exponent > 18){
+    return sign * value * pow(10, exponent);
+  }
+  return sign * value * powersOfTen[exponent];
 }
 
-pl::~pl(){}
+double plToLog(const string & phred){
 
-pl::pl(void){
-  nalt  = 0;
-  nref  = 0;
-  af    = 0;
-  nhomr = 0;
-  nhoma = 0;
-  nhet  = 0;
-  ngeno = 0;
-  fis   = 0;
-  hfrq  = 0;
+  const char * s = phred.c_str();
 
-  alpha = 0.01;
-  beta  = 0.01;
+  int pl = 0;
 
+  while(*s >= '0' && *s <= '9' && pl < PL_TABLE_SIZE){
+    pl = pl * 10 + (*s - '0');
+    s++;
+  }
+  if(*s == '\0' && pl < PL_TABLE_SIZE){
+    return plTable[pl];
+  }
+  return -fastAtof(phred.c_str()) * (M_LN10 / 10);
 }
 
-gp::~gp(){}
-
-gp::gp(void){
-  nalt  = 0;
-  nref  = 0;
-  af    = 0;
-  nhomr = 0;
-  nhoma = 0;
-  nhet  = 0;
-  ngeno = 0;
-  fis   = 0;
-  hfrq  = 0;
+genotype::~genotype(){}
 
-  alpha = 0.01;
-  beta  = 0.01;
+zvar::~zvar(){}
 
+void zvar::setPopName(string  popName){
+  name = popName;
 }
 
-gt::~gt(){}
+pooled::~pooled(){}
 
-gt::gt(void){
+void genotype::reset(void){
+  npop  = 0;
   nalt  = 0;
   nref  = 0;
   af    = 0;
@@ -85,79 +135,137 @@ gt::gt(void){
   ngeno = 0;
   fis   = 0;
   hfrq  = 0;
+  eaf   = 0;
 
-  alpha = 0.01;
-  beta  = 0.01;
+  alpha = GENOTYPE_PRIOR;
+  beta  = GENOTYPE_PRIOR;
 
+  genoIndex.clear();
+  gtCodes.clear();
+  genoLikelihoods.clear();
+  genoLikelihoodsCDF.clear();
 }
 
-pooled::pooled(void){
-
+void pooled::reset(void){
   npop   = 0;
   afsum  = 0;
   nalt   = 0;
   nref   = 0;
   af     = 0;
-  npop   = 0;
   ntot   = 0;
 
   alpha  = 0.01;
   beta   = 0.01;
 
+  nalts.clear();
+  nrefs.clear();
+  afs.clear();
+}
+
+double pooled::bound(double v){
+  if(v <= 0.00001){
+    return  0.00001;
+  }
+  if(v >= 0.99999){
+    return 0.99999;
+  }
+  return v;
+}
+
+gl::~gl(){}
+
+gl::gl(void){
+  reset();
+}
+
+pl::~pl(){}
+
+pl::pl(void){
+  reset();
 }
 
-// polymorphism for GL and PL
+gp::~gp(){}
 
-double gt::unphred(map< string, vector<string> > & geno, int index){
-  return -1;
+gp::gp(void){
+  reset();
 }
 
-double gl::unphred(map< string, vector<string> > & geno, int index){
- 
-  double unphreded = atof(geno["GL"][index].c_str());
-  return unphreded;
+gt::~gt(){}
+
+gt::gt(void){
+  reset();
 }
 
-double gp::unphred(map< string, vector<string> > & geno, int index){
- 
-  double unphreded = atof(geno["GP"][index].c_str());
-  return log(unphreded) ;
+pooled::pooled(void){
+  reset();
 }
 
-double pl::unphred(map< string, vector<string> > & geno, int index){
+int formatType(const string & type){
+  if(type == "GT"){
+    return FORMAT_GT;
+  }
+  if(type == "GL"){
+    return FORMAT_GL;
+  }
+  if(type == "GP"){
+    return FORMAT_GP;
+  }
+  if(type == "PL"){
+    return FORMAT_PL;
+  }
+  if(type == "PO"){
+    return FORMAT_PO;
+  }
+  return FORMAT_NA;
+}
 
-   double unphreded = atof(geno["PL"][index].c_str());
+genotype * newGenotype(int format){
+  switch(format){
+  case FORMAT_GT:
+    return new gt();
+  case FORMAT_GL:
+    return new gl();
+  case FORMAT_GP:
+    return new gp();
+  case FORMAT_PL:
+    return new pl();
+  default:
+    return NULL;
+  }
+}
 
-   unphreded = log(pow(10, (-unphreded/10)));
-     
-   return unphreded;
+zvar * newPopulation(int format){
+  if(format == FORMAT_PO){
+    return new pooled();
+  }
+  return newGenotype(format);
 }
 
-void pooled::loadPop(vector< map< string, vector<string> > > & group, string seqid, long int position){
-  vector< map< string, vector<string> > >::iterator targ_it = group.begin();
+void pooled::loadPop(vector< map< string, vector<string> > * > & group, string seqid, long int position){
+  vector< map< string, vector<string> > * >::iterator targ_it = group.begin();
 
 
   for(; targ_it != group.end(); targ_it++){
 
-    string genotype = (*targ_it)["GT"].front();
+    map< string, vector<string> > & sample = **targ_it;
 
-    if(genotype == "./."){
+    if(sample["GT"].front() == "./."){
       continue;
     }
 
-    string allelecounts = (*targ_it)["AD"].front();
-
-    vector<string> ac   = (*targ_it)["AD"];
+    vector<string> & ac = sample["AD"];
     
     npop += 1;
     
+    double refCount = fastAtof(ac[0].c_str());
+    double altCount = fastAtof(ac[1].c_str());
 
-    double af = atof(ac[1].c_str()) / ( atof(ac[0].c_str()) + atof(ac[1].c_str()) );
+    double af = altCount / ( refCount + altCount );
 
-    if(atof(ac[1].c_str()) == 0){
+    if(altCount == 0){
       af = 0;
     }
-    if(atof(ac[0].c_str()) == 0){
+    if(refCount == 0){
       af = 1;
     }
         
@@ -165,13 +273,13 @@ void pooled::loadPop(vector< map< string, vector<string> > > & group, string seq
 				 
     afs.push_back(af);
 
-    nrefs.push_back(atof(ac[0].c_str()));
-    nalts.push_back(atof(ac[1].c_str()));
+    nrefs.push_back(refCount);
+    nalts.push_back(altCount);
 
-    nref += atof(ac[0].c_str());
-    ntot += atof(ac[0].c_str());
-    nalt += atof(ac[1].c_str());
-    ntot += atof(ac[1].c_str());
+    nref += refCount;
+    ntot += refCount;
+    nalt += altCount;
+    ntot += altCount;
   }
   if(npop < 1){
     af = -1;
@@ -191,9 +299,9 @@ void genotype::estimatePosterior(void){
       continue;
     }
 
-    double aa = genoLikelihoods[i][0] ;
-    double ab = genoLikelihoods[i][1] ;
-    double bb = genoLikelihoods[i][2] ;
+    double aa = genoLikelihoods[3*i    ] ;
+    double ab = genoLikelihoods[3*i + 1] ;
+    double bb = genoLikelihoods[3*i + 2] ;
 
     alpha += exp(ab);
     beta  += exp(ab);
@@ -235,136 +343,112 @@ void pooled::estimatePosterior(void){
   }
 }
 
-void genotype::loadPop( vector< map< string, vector<string> > >& group, string seqid, long int position){
+template<class policy>
+void genotype::loadGenotypes( vector< map< string, vector<string> > * >& group, string seqid, long int position){
+
+  this->seqid = seqid;
+  pos         = position;
 
-  seqid = seqid;
-  pos   = position  ;
+  double dosage = 0;
 
-  vector< map< string, vector<string> > >::iterator targ_it = group.begin();
+  vector< map< string, vector<string> > * >::iterator targ_it = group.begin();
 
   for(; targ_it != group.end(); targ_it++){
-        
-    string genotype = (*targ_it)["GT"].front();
 
-    gts.push_back(genotype);
+    map< string, vector<string> > & sample = **targ_it;
 
-    vector<double> phreds;
-    vector<double> phredsCDF;
+    const string & genotype = sample["GT"].front();
 
-    double sum  = 0;
-    if(genotype != "./."){
-
-      double pa  =  unphred( (*targ_it), 0)  ;
-      double pab =  unphred( (*targ_it), 1)  ;
-      double pbb =  unphred( (*targ_it), 2)  ;
-
-      double norm = log(exp(pa) + exp(pab) + exp(pbb))  ;
-
-      phreds.push_back(pa  - norm);
-      phreds.push_back(pab - norm);
-      phreds.push_back(pbb - norm);
-
-      
-       // cerr << exp(pa  - norm) << endl;
-       // cerr << exp(pab - norm) << endl;
-       // cerr << exp(pbb - norm) << endl;
-       // cerr << endl;
-
-      sum += exp(pa - norm);
-      //      cerr << sum << endl;
-      phredsCDF.push_back(sum);
-      sum += exp(pab - norm);
-      //      cerr << sum << endl;
-      phredsCDF.push_back(sum);
-      sum += exp(pbb - norm);
-      //      cerr << sum << endl;
-      //      cerr << endl;
-      phredsCDF.push_back(sum);
-    }
-    else{
-      phreds.push_back(log(1/3));
-      phreds.push_back(log(1/3));
-      phreds.push_back(log(1/3));
-      phredsCDF.push_back(1/3);
-      phredsCDF.push_back(2/3);
-      phredsCDF.push_back(1);
+    unsigned char code = gtCode(genotype);
+
+    if(code == GT_UNKNOWN){
+      cerr << "FATAL: unknown genotype: " << genotype << endl;
+      exit(1);
     }
 
-    genoLikelihoods.push_back(phreds);
-    genoLikelihoodsCDF.push_back(phredsCDF);
+    gtCodes.push_back(code);
 
-    if(genotype == "./0" || genotype == "./1"){
-      genotype = "./.";
-    }
+    double sum  = 0;
+    if(!(code & GT_MISSING)){
 
-    while(1){
-      if(genotype == "./."){
-        genoIndex.push_back(-1);
-        break;
-      }
-      if(genotype == "0/0"){
-        ngeno += 1;
-        nhomr += 1;
-        nref  += 2;
-        genoIndex.push_back(0);
-        break;
-      }
-      if(genotype == "0/1"){
-        ngeno += 1;
-        nhet  += 1;
-        nref  += 1;
-        nalt  += 1;
-        genoIndex.push_back(1);
-        break;
-      }
-      if(genotype == "1/0"){
-        ngeno += 1;
-        nhet  += 1;
-	nref  += 1;
-        nalt  += 1;
-        genoIndex.push_back(1);
-        break;
-      }
-      if(genotype == "1/1"){
-	ngeno += 1;
-        nhoma += 1;
-        nalt  += 2;
-        genoIndex.push_back(2);
-        break;
-      }
-      if(genotype == "0|0"){
-        ngeno += 1;
-        nhomr += 1;
-        nref  += 2;
-        genoIndex.push_back(0);
-        break;
+      double pa  ;
+      double pab ;
+      double pbb ;
+
+      if(policy::likelihoods){
+
+	map< string, vector<string> >::iterator field = sample.find(policy::field());
+
+	if(field == sample.end() || field->second.size() < 3){
+	  cerr << "FATAL: missing or malformed " << policy::field() << " field at: " << position << endl;
+	  exit(1);
+	}
+
+	pa  = policy::unphred(field->second[0]);
+	pab = policy::unphred(field->second[1]);
+	pbb = policy::unphred(field->second[2]);
       }
-      if(genotype == "0|1"){
-        ngeno += 1;
-        nhet  += 1;
-        nref  += 1;
-        nalt  += 1;
-        genoIndex.push_back(1);
-        break;
+      else{
+	pa  = policy::unphred(genotype);
+	pab = pa;
+	pbb = pa;
       }
-      if(genotype == "1|0"){
-        ngeno += 1;
-        nhet  += 1;
-        nref  += 1;
-        nalt  += 1;
-        genoIndex.push_back(1);
-        break;
+
+      // log-sum-exp around the best genotype; the three exponentials
+      // are computed once and reused for the CDF
+
+      double best = pa;
+      if(pab > best){
+	best = pab;
       }
-      if(genotype == "1|1"){
-        ngeno += 1;
-        nhoma += 1;
-        nalt  += 2;
-        genoIndex.push_back(2);
-        break;
+      if(pbb > best){
+	best = pbb;
       }
-      cerr << "FATAL: unknown genotype: " << genotype << endl;
-      exit(1);
+
+      double ea  = exp(pa  - best);
+      double eab = exp(pab - best);
+      double ebb = exp(pbb - best);
+      double tot = ea + eab + ebb;
+
+      double norm = best + log(tot);
+
+      genoLikelihoods.push_back(pa  - norm);
+      genoLikelihoods.push_back(pab - norm);
+      genoLikelihoods.push_back(pbb - norm);
+
+      sum += ea / tot;
+      genoLikelihoodsCDF.push_back(sum);
+      sum += eab / tot;
+      genoLikelihoodsCDF.push_back(sum);
+      sum += ebb / tot;
+      genoLikelihoodsCDF.push_back(sum);
+
+      dosage += (eab + 2 * ebb) / tot;
+    }
+    else{
+      genoLikelihoods.push_back(log(1.0/3));
+      genoLikelihoods.push_back(log(1.0/3));
+      genoLikelihoods.push_back(log(1.0/3));
+      genoLikelihoodsCDF.push_back(1.0/3);
+      genoLikelihoodsCDF.push_back(2.0/3);
+      genoLikelihoodsCDF.push_back(1);
+    }
+
+    if(code & GT_MISSING){
+      genoIndex.push_back(-1);
+      continue;
     }
+
+    int altCount = gtAltCount(code);
+
+    ngeno += 1;
+    nalt  += altCount;
+    nref  += 2 - altCount;
+    nhomr += (altCount == 0);
+    nhet  += (altCount == 1);
+    nhoma += (altCount == 2);
+
+    genoIndex.push_back(altCount);
   }
   if(nalt == 0 && nref == 0){
     af = -1;
@@ -384,4 +468,100 @@ void genotype::loadPop( vector< map< string, vector<string> > >& group, string s
   }
   hfrq = nhet / ngeno;
   npop = ngeno;
+
+  if(!policy::likelihoods || ngeno == 0){
+    eaf = af;
+  }
+  else{
+    eaf = dosage / (2 * ngeno);
+  }
+}
+
+void gt::loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position){
+  loadGenotypes<gtPolicy>(group, seqid, position);
+}
+
+void gl::loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position){
+  loadGenotypes<glPolicy>(group, seqid, position);
+}
+
+void gp::loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position){
+  loadGenotypes<gpPolicy>(group, seqid, position);
+}
+
+void pl::loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position){
+  loadGenotypes<plPolicy>(group, seqid, position);
+}
+
+double binomialLrt(double x1, double n1, double p1, double x2, double n2, double p2, double p0){
+
+  double lp0 = log(p0);
+  double lq0 = log(1 - p0);
+
+  double l = x1 * (log(p1) - lp0) + (n1 - x1) * (log(1 - p1) - lq0)
+           + x2 * (log(p2) - lp0) + (n2 - x2) * (log(1 - p2) - lq0);
+
+  return 2 * l;
+}
+
+void loadSampleFile(string filename, vector<string> & names){
+
+  ifstream sampleFile(filename.c_str());
+
+  if(!sampleFile.is_open()){
+    cerr << "FATAL: could not open sample file: " << filename << endl;
+    exit(1);
+  }
+
+  string line;
+
+  while(getline(sampleFile, line)){
+    vector<string> fields = split(line, " \t\r");
+    for(vector<string>::iterator it = fields.begin(); it != fields.end(); it++){
+      if(!(*it).empty()){
+	names.push_back(*it);
+      }
+    }
+  }
+}
+
+vector<char> sampleMembership(vector<string> & sampleNames, map<int, int> & indices,
+                              vector<string> & names, string group){
+
+  int nsamples = sampleNames.size();
+
+  vector<char> member(nsamples, 0);
+
+  for(map<int, int>::iterator it = indices.begin(); it != indices.end(); it++){
+    if(it->first < 0 || it->first >= nsamples){
+      cerr << "FATAL: " << group << " individual is not a VCF column: " << it->first << endl;
+      exit(1);
+    }
+    member[it->first] = 1;
+  }
+
+  if(!names.empty()){
+
+    map<string, int> columns;
+    for(int i = 0; i < nsamples; i++){
+      columns[sampleNames[i]] = i;
+    }
+
+    for(vector<string>::iterator it = names.begin(); it != names.end(); it++){
+      map<string, int>::iterator column = columns.find(*it);
+      if(column == columns.end()){
+	cerr << "FATAL: " << group << " sample is not in the VCF: " << *it << endl;
+	exit(1);
+      }
+      member[column->second] = 1;
+    }
+
+    int n = 0;
+    for(int i = 0; i < nsamples; i++){
+      n += member[i];
+    }
+    cerr << "INFO: there are " << n << " individuals in the " << group << endl;
+  }
+
+  return member;
 }
@@ -14,6 +14,94 @@
 
 using namespace std;
 
+// locale free parsing of numeric FORMAT fields; much cheaper than atof
+
+double fastAtof(const char * s);
+
+// natural log likelihood of a phred scaled PL, small integers come from a table
+
+double plToLog(const string & phred);
+
+// compact genotype codes: bits 0 and 1 are the two alleles, bit 2 marks a
+// phased call and bit 3 a missing one.  Anything that is not a biallelic
+// diploid call decodes to GT_UNKNOWN.
+
+#define GT_PHASED  4
+#define GT_MISSING 8
+#define GT_UNKNOWN 255
+
+inline unsigned char gtCode(const string & gt){
+
+  if(gt.size() != 3){
+    return gt == "." ? GT_MISSING : GT_UNKNOWN;
+  }
+
+  unsigned int a = gt[0] - '0';
+  unsigned int b = gt[2] - '0';
+  unsigned char phased = (gt[1] == '|') ? GT_PHASED : 0;
+
+  if(gt[1] != '/' && gt[1] != '|'){
+    return GT_UNKNOWN;
+  }
+  if(gt[0] == '.' || gt[2] == '.'){
+    return GT_MISSING | phased;
+  }
+  if(a > 1 || b > 1){
+    return GT_UNKNOWN;
+  }
+  return a | (b << 1) | phased;
+}
+
+inline int gtFirst(unsigned char code){
+  return code & 1;
+}
+
+inline int gtSecond(unsigned char code){
+  return (code >> 1) & 1;
+}
+
+inline int gtAltCount(unsigned char code){
+  return (code & 1) + ((code >> 1) & 1);
+}
+
+// genotype likelihood formats; the --type string is resolved once at startup
+
+enum genotypeFormat { FORMAT_NA = -1, FORMAT_GT, FORMAT_GL, FORMAT_GP, FORMAT_PL, FORMAT_PO };
+
+int formatType(const string & type);
+
+// format policies: which FORMAT field holds the likelihoods and how a
+// single value becomes a natural log likelihood.  genotype::loadGenotypes
+// is instantiated per policy so the per-sample loop has no virtual calls.
+
+struct gtPolicy{
+  static const bool likelihoods = false;
+  static const char * field(void){ return "GT"; }
+  static double unphred(const string &){ return -1; }
+};
+
+struct glPolicy{
+  static const bool likelihoods = true;
+  static const char * field(void){ return "GL"; }
+  static double unphred(const string & value){ return fastAtof(value.c_str()); }
+};
+
+struct gpPolicy{
+  static const bool likelihoods = true;
+  static const char * field(void){ return "GP"; }
+  static double unphred(const string & value){ return log(fastAtof(value.c_str())); }
+};
+
+struct plPolicy{
+  static const bool likelihoods = true;
+  static const char * field(void){ return "PL"; }
+  static double unphred(const string & value){ return plToLog(value); }
+};
+
+// the beta prior on the allele counts that reset() seeds alpha and beta with
+
+#define GENOTYPE_PRIOR 0.01
+
 class zvar{
 public:
 
@@ -31,8 +119,13 @@ public:
   double alpha; 
   double beta ;
 
-  virtual void loadPop(vector< map< string, vector<string> > >& group, string seqid, long int position) = 0;
+  virtual void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position) = 0;
   virtual void estimatePosterior() = 0 ;
+
+  // zeroes the counts and empties the vectors without releasing their
+  // memory, so one object can be reused for every site
+
+  virtual void reset() = 0;
   virtual ~zvar() = 0;
   void setPopName(string  popName);
   
@@ -48,17 +141,27 @@ public:
   double ngeno;
   double fis  ;
   double hfrq ;
+
+  // alternate allele frequency from the expected dosage of each called
+  // sample under its likelihoods; the hard call frequency for GT
+
+  double eaf  ;
   
   vector<int> genoIndex;
-  vector<string> gts ;
-  vector< vector < double > > genoLikelihoods;
-  vector< vector < double > > genoLikelihoodsCDF;
+  vector<unsigned char> gtCodes;
+
+  // three values per sample (aa, ab, bb): normalised log likelihoods and their CDF
+
+  vector<double> genoLikelihoods;
+  vector<double> genoLikelihoodsCDF;
 
-  virtual double unphred(map< string, vector<string> > & geno, int index) = 0; 
-  virtual void loadPop(vector< map< string, vector<string> > >& group, string seqid, long int position);
   virtual ~genotype() = 0;
   void estimatePosterior();
-  
+  void reset();
+
+protected:
+  template<class policy>
+  void loadGenotypes(vector< map< string, vector<string> > * >& group, string seqid, long int position);
 
 };
 
@@ -72,8 +175,9 @@ public:
   vector<double> nrefs;
   vector<double> afs  ; 
 
-  void loadPop(vector< map< string, vector<string> > >& group, string seqid, long int position);
+  void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position);
   void estimatePosterior();
+  void reset();
 
   ~pooled();
 
@@ -86,21 +190,21 @@ public:
 class gt : public genotype{
 public:
   gt(void);
-  double unphred(map< string, vector<string> > & geno, int index);
+  void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position);
   ~gt();
 };
 
 class gl : public genotype{
 public:
   gl(void);
-  double unphred(map< string, vector<string> > & geno, int index);
+  void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position);
   ~gl();
 };
 
 class gp : public genotype{
 public:
   gp(void);
-  double unphred(map< string, vector<string> > & geno, int index);
+  void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position);
   ~gp();
 };
 
@@ -108,8 +212,34 @@ public:
 class pl : public genotype{
 public:
   pl(void);
-  double unphred(map< string, vector<string> > & geno, int index);
+  void loadPop(vector< map< string, vector<string> > * >& group, string seqid, long int position);
   ~pl();
 }; 
 
+// population factories; NULL for a format the class does not handle
+
+genotype * newGenotype(int format);
+zvar     * newPopulation(int format);
+
+// The binomial likelihood ratio statistic of separate allele frequencies
+// (p1, p2) against a shared one (p0) for x alternate alleles out of n.  The
+// binomial coefficients are the same under both models and cancel, so no
+// lgamma is needed.
+
+double binomialLrt(double x1, double n1, double p1, double x2, double n2, double p2, double p0);
+
+// upper tail of a chi-squared with one degree of freedom
+
+inline double chiSquareTail1(double x){
+  return erfc(sqrt(x / 2));
+}
+
+// sample groups are given as zero based VCF columns (--target 0,1,2) or as
+// a file of sample names, one per line (--target-file).  Both are resolved
+// once against the VCF header into one flag per VCF column.
+
+void         loadSampleFile(string filename, vector<string> & names);
+vector<char> sampleMembership(vector<string> & sampleNames, map<int, int> & indices,
+                              vector<string> & names, string group);
+
 #endif 
@@ -12,10 +12,17 @@
 #include <time.h>
 #include <stdio.h>
 #include <getopt.h>
+#include <deque>
+#include <fstream>
 
 using namespace std;
 using namespace vcflib;
 
+// GT input has no likelihoods, so the beta posteriors are the allele
+// counts on this prior
+
+#define GT_PRIOR 0.001
+
 void printVersion(void){
   cerr << endl;
   cerr << "INFO: version 1.1.0 ; date: April 2014 ; author: Zev Kronenberg; email : zev.kronenberg@utah.edu " << endl;
@@ -38,14 +45,43 @@ void printHelp(void){
   cerr << "     4. background allele frequency  "    << endl;
   cerr << "     5. wcFst                        "    << endl  << endl;
 
+  cerr << "Output : with --window, 5 columns :  "    << endl;
+  cerr << "     1. seqid                        "    << endl;
+  cerr << "     2. window start                 "    << endl;
+  cerr << "     3. window end                   "    << endl;
+  cerr << "     4. number of sites              "    << endl;
+  cerr << "     5. windowed wcFst               "    << endl  << endl;
+
+  cerr << "Output : with --populations, 9 columns, one line per pair of populations : " << endl;
+  cerr << "     1. seqid                        "    << endl;
+  cerr << "     2. position                     "    << endl;
+  cerr << "     3. first population             "    << endl;
+  cerr << "     4. second population            "    << endl;
+  cerr << "     5. first allele frequency       "    << endl;
+  cerr << "     6. second allele frequency      "    << endl;
+  cerr << "     7. wcFst                        "    << endl;
+  cerr << "     8. Hudson's Fst                 "    << endl;
+  cerr << "     9. pFst p-value                 "    << endl  << endl;
+
+  cerr << "      Windowed, per seqid and genome-wide estimates are ratios of sums: the sum of the  " << endl;
+  cerr << "      numerators (a) over the sum of the denominators (a+b+c), rather than an average of" << endl;
+  cerr << "      per-site ratios. The per seqid and genome-wide estimates are reported as INFO lines." << endl << endl;
+
   cerr << "INFO: usage:  wcFst --target 0,1,2,3,4,5,6,7 --background 11,12,13,16,17,19,22 --file my.vcf --deltaaf 0.1 --type PL                  " << endl;
   cerr << endl;
   cerr << "INFO: required: t,target     -- argument: a zero based comma separated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: b,background -- argument: a zero based comma separated list of background individuals corrisponding to VCF columns    " << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
   cerr << "INFO: required: f,file       -- argument: proper formatted VCF                                                                        " << endl;
   cerr << "INFO: required, y,type       -- argument: genotype likelihood format; genotype : GL,PL,GP                                             " << endl;
   cerr << "INFO: optional: r,region     -- argument: a tabix compliant genomic range: seqid or seqid:start-end                                   " << endl;
   cerr << "INFO: optional: d,deltaaf    -- argument: skip sites where the difference in allele frequencies is less than deltaaf, default is zero " << endl;
+  cerr << "INFO: optional: p,populations -- argument: a file with one population per line: a name then a zero based comma separated   " << endl;
+  cerr << "                                list of individuals; replaces target and background and scores every pair of populations   " << endl;
+  cerr << "                                in one pass. Genome-wide wcFst and Hudson's Fst matrices are reported as INFO lines.        " << endl;
+  cerr << "INFO: optional: w,window     -- argument: report windowed wcFst over windows of this many base pairs instead of per site     " << endl;
+  cerr << "INFO: optional: s,step       -- argument: window step in base pairs, default is the window size                             " << endl;
 
   printVersion();
 }
@@ -61,6 +97,161 @@ double bound(double v){
   return v;
 }
 
+// The Weir & Cockerham numerator and denominator of the sites in a bp
+// window.  Windows start at multiples of the step; a window is reported
+// once a site at or beyond its end arrives, or the seqid ends.  Sites are
+// kept only while they can still fall in a window, with running sums.
+
+struct fstSite{
+  long int position;
+  double   numerator;
+  double   denominator;
+};
+
+struct fstWindow{
+  string          seqid;
+  long int        size;
+  long int        step;
+  long int        start;
+  double          numerator;
+  double          denominator;
+  deque<fstSite>  sites;
+};
+
+void reportWindow(fstWindow & window){
+  if(window.sites.empty()){
+    return;
+  }
+  cout << window.seqid << "\t" << window.start << "\t" << window.start + window.size
+       << "\t" << window.sites.size() << "\t" << window.numerator / window.denominator << endl;
+}
+
+void advanceWindow(fstWindow & window, long int start){
+  window.start = start;
+  while(!window.sites.empty() && window.sites.front().position < window.start){
+    window.numerator   -= window.sites.front().numerator;
+    window.denominator -= window.sites.front().denominator;
+    window.sites.pop_front();
+  }
+  // an empty window drops any rounding left in the running sums
+  if(window.sites.empty()){
+    window.numerator   = 0;
+    window.denominator = 0;
+  }
+}
+
+void startWindow(fstWindow & window, string & seqid){
+  window.seqid = seqid;
+  window.sites.clear();
+  advanceWindow(window, 0);
+}
+
+void addWindowSite(fstWindow & window, fstSite & site){
+  while(window.start + window.size <= site.position){
+    reportWindow(window);
+    if(window.sites.empty()){
+      // skip ahead to the first window holding this site
+      long int first = (site.position - window.size) / window.step + 1;
+      advanceWindow(window, max(window.start + window.step, first * window.step));
+    }
+    else{
+      advanceWindow(window, window.start + window.step);
+    }
+  }
+  window.sites.push_back(site);
+  window.numerator   += site.numerator;
+  window.denominator += site.denominator;
+}
+
+void finishWindow(fstWindow & window){
+  while(!window.sites.empty()){
+    reportWindow(window);
+    advanceWindow(window, window.start + window.step);
+  }
+}
+
+void reportRatio(string what, double numerator, double denominator, long int nsites){
+  cerr << "INFO: ratio of sums wcFst for " << what << " : " << numerator / denominator
+       << " over " << nsites << " sites" << endl;
+}
+
+// Weir & Cockerham's a, b and c for two populations
+
+void wcComponents(genotype * target, genotype * background, double & avar, double & bvar, double & cvar){
+
+  // pg 1360 B.S Weir and C.C. Cockerham 1984
+  double nbar = ( target->ngeno / 2 ) + (background->ngeno / 2);
+  double rn   = 2*nbar;
+
+  // special case of only two populations
+  double nc   =  rn ;
+  nc -= (pow(target->ngeno,2)/rn);
+  nc -= (pow(background->ngeno,2)/rn);
+  // average sample frequency
+  double pbar = (target->af + background->af) / 2;
+
+  // sample variance of allele A frequences over the population 
+
+  double s2 = 0;
+  s2 += ((target->ngeno * pow(target->af - pbar, 2))/nbar);
+  s2 += ((background->ngeno * pow(background->af - pbar, 2))/nbar);
+
+  // average heterozygosity 
+
+  double hbar = (target->hfrq + background->hfrq) / 2;
+
+  //global af var
+  double pvar = pbar * (1 - pbar);
+
+  // a, b, c
+
+  double avar1 = nbar / nc;
+  double avar2 = 1 / (nbar -1) ;
+  double avar3 = pvar - (0.5*s2) - (0.25*hbar);
+  avar  = avar1 * (s2 - (avar2 * avar3));
+
+  double bvar1 = nbar / (nbar - 1);
+  double bvar2 = pvar - (0.5*s2) - (((2*nbar -1)/(4*nbar))*hbar);
+  bvar  = bvar1 * bvar2;
+
+  cvar = 0.5*hbar;
+}
+
+// Hudson's Fst numerator and denominator, Bhatia et al. 2013 equation 10
+
+void hudsonComponents(genotype * target, genotype * background, double & numerator, double & denominator){
+
+  double p1 = target->af;
+  double p2 = background->af;
+  double n1 = 2 * target->ngeno;
+  double n2 = 2 * background->ngeno;
+
+  numerator   = pow(p1 - p2, 2) - (p1*(1-p1))/(n1-1) - (p2*(1-p2))/(n2-1);
+  denominator = p1*(1-p2) + p2*(1-p1);
+}
+
+// the pFst likelihood ratio test; the beta posteriors of the pooled
+// populations are the sums of the two, less one copy of the prior
+
+double pFstPvalue(genotype * target, genotype * background, double prior){
+
+  double alpha = target->alpha + background->alpha - prior;
+  double beta  = target->beta  + background->beta  - prior;
+
+  double totalEstAF      = bound(beta / (alpha + beta));
+  double targetEstAF     = bound(target->beta     / (target->alpha     + target->beta)    );
+  double backgroundEstAF = bound(background->beta / (background->alpha + background->beta));
+
+  double l = binomialLrt(target->beta,     target->alpha     + target->beta,     targetEstAF,
+                         background->beta, background->alpha + background->beta, backgroundEstAF,
+                         totalEstAF);
+
+  if(l <= 0){
+    return 1;
+  }
+  return chiSquareTail1(l);
+}
+
 void loadIndices(map<int, int> & index, string set){
   
   vector<string>  indviduals = split(set, ",");
@@ -73,6 +264,213 @@ void loadIndices(map<int, int> & index, string set){
 }
 
 
+// reads the populations file: a name then a zero based comma separated
+// list of individuals per line
+
+void loadPopulations(string filename, vector<string> & names, vector< map<int, int> > & indices){
+
+  ifstream popFile(filename.c_str());
+
+  if(!popFile.is_open()){
+    cerr << "FATAL: could not open populations file: " << filename << endl;
+    exit(1);
+  }
+
+  string line;
+
+  while(getline(popFile, line)){
+
+    vector<string> fields;
+    vector<string> tokens = split(line, " \t");
+    for(vector<string>::iterator it = tokens.begin(); it != tokens.end(); it++){
+      if(!(*it).empty()){
+	fields.push_back(*it);
+      }
+    }
+    if(fields.empty()){
+      continue;
+    }
+    if(fields.size() != 2){
+      cerr << "FATAL: populations file lines need a name and a list of individuals: " << line << endl;
+      exit(1);
+    }
+    names.push_back(fields[0]);
+    indices.push_back(map<int, int>());
+    loadIndices(indices.back(), fields[1]);
+
+    cerr << "INFO: there are " << indices.back().size() << " individuals in population " << fields[0] << endl;
+  }
+
+  if(names.size() < 2){
+    cerr << "FATAL: the populations file needs at least two populations" << endl;
+    exit(1);
+  }
+}
+
+void reportMatrix(string what, vector<string> & names, vector<double> & numerator, vector<double> & denominator){
+
+  int npop = names.size();
+
+  cerr << "INFO: genome-wide " << what << " matrix :";
+  for(int i = 0; i < npop; i++){
+    cerr << "\t" << names[i];
+  }
+  cerr << endl;
+
+  for(int i = 0; i < npop; i++){
+    cerr << "INFO: " << names[i];
+    for(int j = 0; j < npop; j++){
+      if(i == j){
+	cerr << "\t0";
+	continue;
+      }
+      int k = i < j ? i * npop + j : j * npop + i;
+      cerr << "\t" << numerator[k] / denominator[k];
+    }
+    cerr << endl;
+  }
+}
+
+// Every pair of populations from one pass over the VCF.  Each population
+// is loaded once per site and then reused by every pair it is part of.
+
+void pairwise(VariantCallFile & variantFile, vector<string> & names, vector< map<int, int> > & indices, int format, double daf){
+
+  vector<string> samples = variantFile.sampleNames;
+  int nsamples = samples.size();
+  int npop     = names.size();
+
+  // the populations of each VCF column
+
+  vector< vector<int> > membership(nsamples);
+
+  for(int p = 0; p < npop; p++){
+    for(map<int, int>::iterator it = indices[p].begin(); it != indices[p].end(); it++){
+      if(it->first < 0 || it->first >= nsamples){
+	cerr << "FATAL: population " << names[p] << " has an individual outside the VCF: " << it->first << endl;
+	exit(1);
+      }
+      membership[it->first].push_back(p);
+    }
+  }
+
+  vector< vector< map< string, vector<string> > * > > groups(npop);
+  vector< genotype * > populations(npop);
+
+  for(int p = 0; p < npop; p++){
+    populations[p] = newGenotype(format);
+  }
+
+  double prior = format == FORMAT_GT ? GT_PRIOR : GENOTYPE_PRIOR;
+
+  vector<double> wcNumerator(npop * npop, 0), wcDenominator(npop * npop, 0);
+  vector<double> hudsonNumerator(npop * npop, 0), hudsonDenominator(npop * npop, 0);
+
+  vector<bool> usable(npop);
+
+  Variant var(variantFile);
+
+  while (variantFile.getNextVariant(var)) {
+
+    if(var.alt.size() > 1){
+      continue;
+    }
+
+    for(int p = 0; p < npop; p++){
+      groups[p].clear();
+    }
+
+    for(int nsamp = 0; nsamp < nsamples; nsamp++){
+      if(membership[nsamp].empty()){
+	continue;
+      }
+      map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
+
+      if(sample["GT"].front() == "./."){
+	continue;
+      }
+      for(vector<int>::iterator it = membership[nsamp].begin(); it != membership[nsamp].end(); it++){
+	groups[*it].push_back(&sample);
+      }
+    }
+
+    for(int p = 0; p < npop; p++){
+      usable[p] = false;
+      if(groups[p].size() < 5){
+	continue;
+      }
+      populations[p]->reset();
+      populations[p]->loadPop(groups[p], var.sequenceName, var.position);
+
+      if(populations[p]->af == -1){
+	continue;
+      }
+      populations[p]->estimatePosterior();
+
+      if(format == FORMAT_GT){
+	populations[p]->alpha = GT_PRIOR + populations[p]->nref;
+	populations[p]->beta  = GT_PRIOR + populations[p]->nalt;
+      }
+      usable[p] = true;
+    }
+
+    for(int i = 0; i < npop; i++){
+      if(!usable[i]){
+	continue;
+      }
+      for(int j = i + 1; j < npop; j++){
+	if(!usable[j]){
+	  continue;
+	}
+
+	genotype * first  = populations[i];
+	genotype * second = populations[j];
+
+	if(first->af == 1 && second->af == 1){
+	  continue;
+	}
+	if(first->af == 0 && second->af == 0){
+	  continue;
+	}
+	if(abs(first->af - second->af) < daf){
+	  continue;
+	}
+
+	double avar, bvar, cvar;
+	wcComponents(first, second, avar, bvar, cvar);
+
+	double hnum, hden;
+	hudsonComponents(first, second, hnum, hden);
+
+	double fst    = avar / (avar+bvar+cvar);
+	double hudson = hnum / hden;
+
+	int k = i * npop + j;
+
+	if(fst == fst){
+	  wcNumerator[k]   += avar;
+	  wcDenominator[k] += avar+bvar+cvar;
+	}
+	if(hudson == hudson){
+	  hudsonNumerator[k]   += hnum;
+	  hudsonDenominator[k] += hden;
+	}
+
+	cout << var.sequenceName << "\t" << var.position << "\t" << names[i] << "\t" << names[j]
+	     << "\t" << first->af << "\t" << second->af
+	     << "\t" << fst << "\t" << hudson << "\t" << pFstPvalue(first, second, prior) << endl;
+      }
+    }
+  }
+
+  reportMatrix("wcFst", names, wcNumerator, wcDenominator);
+  reportMatrix("Hudson's Fst", names, hudsonNumerator, hudsonDenominator);
+
+  for(int p = 0; p < npop; p++){
+    delete populations[p];
+  }
+}
+
 int main(int argc, char** argv) {
 
   // set the random seed for MCMC
@@ -94,6 +492,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -104,6 +506,17 @@ int main(int argc, char** argv) {
 
   string type = "NA";
 
+  // all pairs of populations
+
+  vector<string>          popNames;
+  vector< map<int, int> > popIndices;
+
+  // windowed output
+
+  fstWindow window;
+  window.size = 0;
+  window.step = 0;
+
 
     const struct option longopts[] = 
       {
@@ -111,10 +524,15 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"deltaaf"   , 1, 0, 'd'},
 	{"type"      , 1, 0, 'y'},
 	{"region"    , 1, 0, 'r'},
+	{"window"    , 1, 0, 'w'},
+	{"step"      , 1, 0, 's'},
+	{"populations", 1, 0, 'p'},
 	{0,0,0,0}
       };
 
@@ -123,7 +541,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:chv", longopts, &index);
+	iarg = getopt_long(argc, argv, "y:r:d:t:b:f:w:s:p:chvT:B:", longopts, &index);
 	
 	switch (iarg)
 	  {
@@ -133,6 +551,14 @@ int main(int argc, char** argv) {
 	  case 'v':
 	    printVersion();
 	    return 0;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -160,6 +586,18 @@ int main(int argc, char** argv) {
             cerr << "INFO: set seqid region to : " << optarg << endl;
 	    region = optarg; 
 	    break;
+	  case 'p':
+	    cerr << "INFO: populations file: " << optarg << endl;
+	    loadPopulations(optarg, popNames, popIndices);
+	    break;
+	  case 'w':
+	    window.size = atol(optarg);
+	    cerr << "INFO: reporting wcFst in windows of : " << optarg << endl;
+	    break;
+	  case 's':
+	    window.step = atol(optarg);
+	    cerr << "INFO: window step : " << optarg << endl;
+	    break;
 	  default:
 	    break;
 	  }
@@ -203,11 +641,54 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
+    if(window.size < 0 || window.step < 0 || (window.step > 0 && window.size == 0)){
+      cerr << "FATAL: the window must be set and positive to use a step" << endl;
+      printHelp();
+      return 1;
+    }
+    if(window.step > window.size){
+      cerr << "FATAL: the step cannot be larger than the window, or sites between windows would be lost" << endl;
+      printHelp();
+      return 1;
+    }
+    if(window.step == 0){
+      window.step = window.size;
+    }
+
+    if(!popNames.empty()){
+      if(window.size > 0 || !it.empty() || !ib.empty() || !targetNames.empty() || !backgroundNames.empty()){
+	cerr << "FATAL: populations cannot be combined with target, background or window" << endl;
+	printHelp();
+	return 1;
+      }
+      pairwise(variantFile, popNames, popIndices, format, daf);
+      return 0;
+    }
+
+    // ratio of sums per seqid and over the genome
+
+    string   seqid = "";
+    double   seqidNumerator   = 0, genomeNumerator   = 0;
+    double   seqidDenominator = 0, genomeDenominator = 0;
+    long int seqidSites       = 0, genomeSites       = 0;
+
     Variant var(variantFile);
 
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+  vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+  vector<char> backgroundMember = sampleMembership(samples, ib, backgroundNames, "background");
+
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget     = newGenotype(format);
+    genotype * populationBackground = newGenotype(format);
+
     while (variantFile.getNextVariant(var)) {
         
 	// biallelic sites naturally 
@@ -216,20 +697,22 @@ int main(int argc, char** argv) {
 	  continue;
 	}
 	
-	vector < map< string, vector<string> > > target, background, total;
+	target.clear();
+	background.clear();
+	total.clear();
 	        
 	int index = 0;
 
 	for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-          map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+          map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
 
 	    if(sample["GT"].front() != "./."){
-	      if(it.find(index) != it.end() ){
-		target.push_back(sample);
+	      if(targetMember[index]){
+		target.push_back(&sample);
 	      }
-	      if(ib.find(index) != ib.end()){
-		background.push_back(sample);
+	      if(backgroundMember[index]){
+		background.push_back(&sample);
 	      }
 	    }            
 	    index += 1;
@@ -240,97 +723,87 @@ int main(int argc, char** argv) {
 	  continue;
 	}
 	
-	genotype * populationTarget      ;
-	genotype * populationBackground  ;
-
-	if(type == "PL"){
-	  populationTarget      = new pl();
-	  populationBackground  = new pl();
-	}
-	if(type == "GL"){
-	  populationTarget     = new gl();
-	  populationBackground = new gl();
-	}
-	if(type == "GP"){
-	  populationTarget     = new gp();
-	  populationBackground = new gp();
-	}
-	if(type == "GT"){
-          populationTarget     = new gt();
-          populationBackground = new gt();
-        }
+	populationTarget->reset();
+	populationBackground->reset();
 	
 	populationTarget->loadPop(target, var.sequenceName, var.position);
 	populationBackground->loadPop(background, var.sequenceName, var.position);
 
 	if(populationTarget->af == -1 || populationBackground->af == -1){
-	  delete populationTarget;
-	  delete populationBackground;
 	  continue;
 	}
 	if(populationTarget->af == 1 &&  populationBackground->af == 1){
-	  delete populationTarget;
-          delete populationBackground;
 	  continue;
 	}
 	if(populationTarget->af == 0 &&  populationBackground->af == 0){
-	  delete populationTarget;
-          delete populationBackground;
 	  continue;
 	}
 
 	double afdiff = abs(populationTarget->af - populationBackground->af);
 
         if(afdiff < daf){
-	  delete populationTarget;
-          delete populationBackground;
           continue;
         }
 	
-	// pg 1360 B.S Weir and C.C. Cockerham 1984
-	double nbar = ( populationTarget->ngeno / 2 ) + (populationBackground->ngeno / 2);
-	double rn   = 2*nbar;
-	
-	// special case of only two populations
-	double nc   =  rn ;
-	nc -= (pow(populationTarget->ngeno,2)/rn);
-	nc -= (pow(populationBackground->ngeno,2)/rn);
-	// average sample frequency
-	double pbar = (populationTarget->af + populationBackground->af) / 2;
-
-	// sample variance of allele A frequences over the population 
-	
-	double s2 = 0;
-	s2 += ((populationTarget->ngeno * pow(populationTarget->af - pbar, 2))/nbar);
-	s2 += ((populationBackground->ngeno * pow(populationBackground->af - pbar, 2))/nbar);
-	
-	// average heterozygosity 
+	double avar, bvar, cvar;
+	wcComponents(populationTarget, populationBackground, avar, bvar, cvar);
 	
-	double hbar = (populationTarget->hfrq + populationBackground->hfrq) / 2;
-	
-	//global af var
-	double pvar = pbar * (1 - pbar);
+	double fst = avar / (avar+bvar+cvar);
 
-	// a, b, c
+	if(var.sequenceName != seqid){
+	  if(seqidSites > 0){
+	    reportRatio("seqid " + seqid, seqidNumerator, seqidDenominator, seqidSites);
+	  }
+	  if(window.size > 0 && seqid != ""){
+	    finishWindow(window);
+	  }
+	  seqid            = var.sequenceName;
+	  seqidNumerator   = 0;
+	  seqidDenominator = 0;
+	  seqidSites       = 0;
+	  if(window.size > 0){
+	    startWindow(window, seqid);
+	  }
+	}
 
-	double avar1 = nbar / nc;
-	double avar2 = 1 / (nbar -1) ;
-	double avar3 = pvar - (0.5*s2) - (0.25*hbar);
-	double avar  = avar1 * (s2 - (avar2 * avar3));
-	
-	double bvar1 = nbar / (nbar - 1);
-	double bvar2 = pvar - (0.5*s2) - (((2*nbar -1)/(4*nbar))*hbar);
-	double bvar  = bvar1 * bvar2;
+	// sites without a defined ratio do not enter the sums
+	if(fst == fst){
+	  seqidNumerator   += avar;
+	  seqidDenominator += avar+bvar+cvar;
+	  seqidSites       += 1;
+	  genomeNumerator   += avar;
+	  genomeDenominator += avar+bvar+cvar;
+	  genomeSites       += 1;
+
+	  if(window.size > 0){
+	    fstSite site;
+	    site.position    = var.position;
+	    site.numerator   = avar;
+	    site.denominator = avar+bvar+cvar;
+	    addWindowSite(window, site);
+	  }
+	}
 
-	double cvar = 0.5*hbar;
-	
-	double fst = avar / (avar+bvar+cvar);
+	if(window.size > 0){
+	  continue;
+	}
 	
 	cout << var.sequenceName << "\t"  << var.position << "\t" << populationTarget->af << "\t" << populationBackground->af << "\t" << fst << endl ;
 
-	delete populationTarget;
-	delete populationBackground;
+    }
 
+    if(window.size > 0 && seqid != ""){
+      finishWindow(window);
+    }
+    if(seqidSites > 0){
+      reportRatio("seqid " + seqid, seqidNumerator, seqidDenominator, seqidSites);
     }
+    if(genomeSites > 0){
+      reportRatio("the genome", genomeNumerator, genomeDenominator, genomeSites);
+    }
+
+    delete populationTarget;
+    delete populationBackground;
+
     return 0;		    
 }
@@ -3,6 +3,8 @@
 #include "cdflib.h"
 #include "pdflib.h"
 #include "var.h"
+#include "phaselib.h"
+#include "ehhlib.h"
 
 #include <string>
 #include <iostream>
@@ -25,26 +27,33 @@ void printHelp(void){
   cerr << endl << endl;
   cerr << "INFO: help" << endl;
   cerr << "INFO: description:" << endl;
-  cerr << "     xpEHH estimates haplotype decay between the target and background populations.  Haplotypes are integrated                        " << endl;
-  cerr << "     until EHH in the target and background is less than 0.05. The score is the itegrated EHH (target) / integrated EHH (background). " << endl;
-  cerr << "     xpEHH does NOT integrate over genetic distance, as genetic maps are not availible for most non-model organisms.                  " << endl;
+  cerr << "     xpEHH estimates haplotype decay between the target and background populations.  EHH over both core alleles is integrated  " << endl;
+  cerr << "     to each side until EHH in the target or background is less than 0.001. The score is log(iHH target / iHH background).      " << endl;
+  cerr << "     EHH is integrated over the SNP index unless a genetic map (--map) or physical distance (--physical) is given.                    " << endl;
 
   cerr << "Output : 4 columns :      " << endl;
   cerr << "     1. seqid             " << endl;
   cerr << "     2. position          " << endl;
   cerr << "     3. alllele frequency " << endl;
-  cerr << "     4. EHH-alt           " << endl;
-  cerr << "     5. EHH-ref           " << endl;
+  cerr << "     4. iHH-target        " << endl;
+  cerr << "     5. iHH-background    " << endl;
   cerr << "     6. xpEHH             " << endl << endl;
 
   cerr << "INFO: xpEHH  --target 0,1,2,3,4,5,6,7 --background 11,12,13,16,17,19,22 --file my.vcf                                                " << endl;
   cerr << endl;
 
   cerr << "INFO: required: t,target     -- argument: a zero based comma separated list of target individuals corrisponding to VCF columns        " << endl;
+  cerr << "INFO: optional: T,target-file -- argument: a file of target sample names, one per line; adds to --target" << endl;
   cerr << "INFO: required: b,background -- argument: a zero based comma separated list of background individuals corrisponding to VCF columns    " << endl;
+  cerr << "INFO: optional: B,background-file -- argument: a file of background sample names, one per line; adds to --background" << endl;
   cerr << "INFO: required: f,file       -- argument: a properly formatted phased VCF file                                                        " << endl;
   cerr << "INFO: required: y,type       -- argument: type of genotype likelihood: PL, GL or GP                                                   " << endl;
   cerr << "INFO: optional: r,region     -- argument: a tabix compliant genomic range: seqid or seqid:start-end                                   " << endl;
+  cerr << "INFO: optional: P,phase      -- flag    : phase the genotypes (or likelihoods) with a Li and Stephens HMM; input may be unphased    " << endl;
+  cerr << "INFO: optional: K,states     -- argument: copying states per individual for --phase [16]                                              " << endl;
+  cerr << "INFO: optional: m,map        -- argument: genetic map, one \"seqid position cM\" per line; integrate over cM                             " << endl;
+  cerr << "INFO: optional: p,physical   -- flag    : integrate over base pairs rather than the SNP index                                            " << endl;
+  cerr << "INFO: optional: x,max-extend -- argument: stop extending haplotypes this far from the core, in the integration units                   " << endl;
   cerr << endl;
  
   printVersion();
@@ -52,13 +61,6 @@ void printHelp(void){
   exit(1);
 }
 
-void clearHaplotypes(string haplotypes[][2], int ntarget){
-  for(int i= 0; i < ntarget; i++){
-    haplotypes[i][0].clear();
-    haplotypes[i][1].clear();
-  }
-}
-
 void loadIndices(map<int, int> & index, string set){
   
   vector<string>  indviduals = split(set, ",");
@@ -69,129 +71,135 @@ void loadIndices(map<int, int> & index, string set){
   }
 }
 
-void calc(string haplotypes[][2], int nhaps, vector<long int> pos, vector<double> afs, vector<int> & target, vector<int> & background, string seqid){
+// EHH of a population over both core alleles: the identical pairs among
+// the haplotypes carrying either allele over all same-allele pairs.
 
-  for(int snp = 0; snp < haplotypes[0][0].length(); snp++){
-    
-    double ehhsat = 1;
-    double ehhsab = 1;
+double siteEHH(ehhScan & scan, int population, int steps){
 
-    double ehhAT = 1 ;
-    double ehhAB = 1 ;
+  int ref = scan.count(population, 0);
+  int alt = scan.count(population, 1);
 
-    int start = snp;
-    int end   = snp;
-    int core  = snp; 
+  double total = 0.5 * ref * (ref - 1) + 0.5 * alt * (alt - 1);
 
-    while( ehhAT > 0.001 && ehhAB > 0.001 ) {
-     
-      start -= 1;
-      end   += 1;
-      
-      if(start == -1){
+  if(total == 0){
+    return 0;
+  }
+  return (scan.pairs(population, 0, steps) + scan.pairs(population, 1, steps)) / total;
+}
+
+// The target (population 0) and background (population 1) haplotypes are
+// swept together, so each extension step partitions them once.  Both are
+// extended out to each side a site per step until the EHH of either drops
+// below 0.001.  Each side stops on its own, at its contig end or at
+// maxExtend.  Each iHH is the trapezoid integral of EHH, a step weighted
+// by the distance it adds.
+
+void integrateSide(haplotypeMatrix & haplotypes, vector<int> & pooled, vector<int> & populations, vector<double> & coordinates,
+		   double maxExtend, int direction, vector<double> & iHHT, vector<double> & iHHB){
+
+  ehhScan scan;
+  scan.start(haplotypes, pooled, populations, direction);
+
+  int nsites = haplotypes.nsites;
+
+  while(scan.next()){
+
+    int snp = scan.core();
+
+    scan.decay();
+
+    double ehhT = 1;
+    double ehhB = 1;
+
+    for(int steps = 1; ehhT > 0.001 && ehhB > 0.001; steps++){
+
+      int site = snp - direction * steps;
+
+      if(site < 0 || site >= nsites){
 	break;
       }
-      if(end == haplotypes[0][0].length() - 1){
+      if(maxExtend >= 0 && fabs(coordinates[site] - coordinates[snp]) > maxExtend){
 	break;
       }
-      
-      map<string , int> targetH, backgroundH;
-
-      double sumrT = 0;
-      double sumaT = 0;
-      double sumrB = 0;
-      double sumaB = 0;
-      double nrefT = 0;
-      double naltT = 0;
-      double nrefB = 0;
-      double naltB = 0;
-
-      // hashing haplotypes into maps for both chr1 and chr2 target[][1 & 2]
-
-      for(int i = 0; i < target.size(); i++){
-	targetH[ haplotypes[target[i]][0].substr(start, (end - start)) ]++;
-	targetH[ haplotypes[target[i]][1].substr(start, (end - start)) ]++;
-      }
-      for(int i = 0; i < background.size(); i++){
-	backgroundH[ haplotypes[background[i]][0].substr(start, (end - start)) ]++;
-	backgroundH[ haplotypes[background[i]][0].substr(start, (end - start)) ]++;
-      }
 
-      // interating over the target populations haplotypes
-      for( map<string, int>::iterator th = targetH.begin(); th != targetH.end(); th++){    	
-	// grabbing the core SNP (*th).first.substr((end-start)/2, 1) == "1"
-	if( (*th).first.substr((end-start)/2, 1) == "1"){     
-	   sumaT += r8_choose(th->second, 2);  
-	   naltT += th->second;
-	}
-	else{
-	  sumrT += r8_choose(th->second, 2);  
-	  nrefT += th->second;
-	}
-      }
+      double step = fabs(coordinates[site] - coordinates[site + direction]);
 
-      // integrating over the background populations haplotypes
-      for( map<string, int>::iterator bh = backgroundH.begin(); bh != backgroundH.end(); bh++){
-	// grabbing the core SNP (*bh).first.substr((end-start)/2, 1) == "1"
-        if( (*bh).first.substr((end - start)/2 , 1) == "1"){
-	  sumaB += r8_choose(bh->second, 2);
-	  naltB += bh->second;
-        }
-        else{
-          sumrB += r8_choose(bh->second, 2);
-          nrefB += bh->second;
-        }
-      }
-      
-      ehhAT = sumaT / (r8_choose(naltT, 2));
-      ehhAB = sumaB / (r8_choose(naltB, 2));
-            
-      ehhsat += ehhAT;
-      ehhsab += ehhAB;
-    } 
-    if(std::isnan(ehhsat) || std::isnan(ehhsab)){
-      continue;
+      double ehhTC = siteEHH(scan, 0, steps);
+      double ehhBC = siteEHH(scan, 1, steps);
+
+      iHHT[snp] += (ehhT + ehhTC) / 2 * step;
+      iHHB[snp] += (ehhB + ehhBC) / 2 * step;
+
+      ehhT = ehhTC;
+      ehhB = ehhBC;
     }
-    cout << seqid << "\t" << pos[snp] << "\t" << afs[snp] << "\t" << ehhsat << "\t" << ehhsab << "\t" << log(ehhsat/ehhsab) << endl;
-  }   
+  }
 }
 
-double EHH(string haplotypes[][2], int nhaps){
+void calc(haplotypeMatrix & haplotypes, vector<long int> & pos, vector<double> & afs, vector<double> & coordinates, vector<int> & target, vector<int> & background, double maxExtend, string seqid){
 
-  map<string , int> hapcounts;
+  int nsites = haplotypes.nsites;
 
-  for(int i = 0; i < nhaps; i++){
-    hapcounts[ haplotypes[i][0] ]++;
-    hapcounts[ haplotypes[i][1] ]++;
-  }
+  vector<int> pooled(target);
+  vector<int> populations(target.size(), 0);
 
-  double sum = 0;
-  double nh  = 0;
+  pooled.insert(pooled.end(), background.begin(), background.end());
+  populations.resize(pooled.size(), 1);
 
-  for( map<string, int>::iterator it = hapcounts.begin(); it != hapcounts.end(); it++){
-    nh  += it->second; 
-    sum += r8_choose(it->second, 2);
-  }
+  vector<double> iHHT(nsites, 0);
+  vector<double> iHHB(nsites, 0);
 
-  double max = (sum /  r8_choose(nh, 2));
-  
-  return max;
+  integrateSide(haplotypes, pooled, populations, coordinates, maxExtend,  1, iHHT, iHHB);
+  integrateSide(haplotypes, pooled, populations, coordinates, maxExtend, -1, iHHT, iHHB);
+
+  for(int snp = 0; snp < nsites; snp++){
 
+    // nothing integrated (no room to extend within maxExtend) leaves the ratio undefined
+
+    if(iHHT[snp] == 0 || iHHB[snp] == 0){
+      continue;
+    }
+
+    cout << seqid << "\t" << pos[snp] << "\t" << afs[snp] << "\t" << iHHT[snp] << "\t" << iHHB[snp] << "\t" << log(iHHT[snp]/iHHB[snp]) << endl;
+  }
 }
 
-void loadPhased(string haplotypes[][2], genotype * pop, int ntarget){
-  
+void loadPhased(haplotypeMatrix & haplotypes, genotype * pop){
+
+  // missing calls carry the reference allele
+
+  haplotypes.addSite();
+
   int indIndex = 0;
 
-  for(vector<string>::iterator ind = pop->gts.begin(); ind != pop->gts.end(); ind++){
-    string g = (*ind);
-    vector< string > gs = split(g, "|");
-    haplotypes[indIndex][0].append(gs[0]);
-    haplotypes[indIndex][1].append(gs[1]);
+  for(vector<unsigned char>::iterator ind = pop->gtCodes.begin(); ind != pop->gtCodes.end(); ind++){
+    if(gtFirst(*ind)){
+      haplotypes.setAlt(2*indIndex);
+    }
+    if(gtSecond(*ind)){
+      haplotypes.setAlt(2*indIndex + 1);
+    }
     indIndex += 1;
   }
 }
 
+// phases the buffered contig and fills the haplotypes from the copying model
+
+void loadPhaser(haplotypeMatrix & haplotypes, lsPhaser & phaser){
+
+  phaser.phase();
+
+  for(int site = 0; site < phaser.nsites(); site++){
+    haplotypes.addSite();
+    for(int h = 0; h < phaser.nhaplotypes(); h++){
+      if(phaser.allele(h, site)){
+	haplotypes.setAlt(h);
+      }
+    }
+  }
+  phaser.clear();
+}
+
 int main(int argc, char** argv) {
 
   // set the random seed for MCMC
@@ -213,6 +221,10 @@ int main(int argc, char** argv) {
   // zero based index for the target and background indivudals 
   
   map<int, int> it, ib;
+
+  // sample names from --target-file and --background-file
+
+  vector<string> targetNames, backgroundNames;
   
   // deltaaf is the difference of allele frequency we bother to look at 
 
@@ -221,9 +233,20 @@ int main(int argc, char** argv) {
 
   int counts = 0;
   
-  // phased 
+  // phase the genotypes with the copying model rather than require phased input
+
+  int phase  = 0;
+  int states = PHASE_STATES;
+
+  // integrate over cM from a genetic map, over bp, or over the SNP index
 
-  int phased = 0;
+  geneticMap gmap;
+
+  int physical = 0;
+
+  // no cap on the extension by default
+
+  double maxExtend = -1;
 
   string type = "NA";
 
@@ -233,9 +256,16 @@ int main(int argc, char** argv) {
 	{"help"      , 0, 0, 'h'},
         {"file"      , 1, 0, 'f'},
 	{"target"    , 1, 0, 't'},
+	{"target-file", 1, 0, 'T'},
 	{"background", 1, 0, 'b'},
+	{"background-file", 1, 0, 'B'},
 	{"region"    , 1, 0, 'r'},
 	{"type"      , 1, 0, 'y'},
+	{"phase"     , 0, 0, 'P'},
+	{"states"    , 1, 0, 'K'},
+	{"map"       , 1, 0, 'm'},
+	{"physical"  , 0, 0, 'p'},
+	{"max-extend", 1, 0, 'x'},
 
 	{0,0,0,0}
       };
@@ -245,7 +275,7 @@ int main(int argc, char** argv) {
 
     while(iarg != -1)
       {
-	iarg = getopt_long(argc, argv, "y:r:t:b:f:hv", longopts, &findex);
+	iarg = getopt_long(argc, argv, "y:r:t:b:f:hvT:B:PK:m:px:", longopts, &findex);
 	
 	switch (iarg)
 	  {
@@ -256,6 +286,34 @@ int main(int argc, char** argv) {
 	  case 'y':
 	    type = optarg;
 	    break;
+	  case 'P':
+	    phase = 1;
+	    cerr << "INFO: phasing genotypes with the Li and Stephens model" << endl;
+	    break;
+	  case 'K':
+	    states = atoi(optarg);
+	    cerr << "INFO: copying states per individual: " << states << endl;
+	    break;
+	  case 'm':
+	    gmap.load(optarg);
+	    cerr << "INFO: genetic map: " << optarg << endl;
+	    break;
+	  case 'p':
+	    physical = 1;
+	    cerr << "INFO: integrating over physical distance" << endl;
+	    break;
+	  case 'x':
+	    maxExtend = atof(optarg);
+	    cerr << "INFO: maximum extension from the core: " << maxExtend << endl;
+	    break;
+	  case 'T':
+	    loadSampleFile(optarg, targetNames);
+	    cerr << "INFO: target sample file: " << optarg << endl;
+	    break;
+	  case 'B':
+	    loadSampleFile(optarg, backgroundNames);
+	    cerr << "INFO: background sample file: " << optarg << endl;
+	    break;
 	  case 't':
 	    loadIndices(it, optarg);
 	    cerr << "INFO: there are " << it.size() << " individuals in the target" << endl;
@@ -296,6 +354,8 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    int format = formatType(type);
+
     if(filename == "NA"){
       cerr << "FATAL: did not specify a file" << endl;
       printHelp();
@@ -322,19 +382,22 @@ int main(int argc, char** argv) {
     vector<string> samples = variantFile.sampleNames;
     int nsamples = samples.size();
 
+    vector<char> targetMember     = sampleMembership(samples, it, targetNames, "target");
+    vector<char> backgroundMember = sampleMembership(samples, ib, backgroundNames, "background");
+
     vector<int> target_h, background_h;
 
-    int index, indexi = 0;
+    int index = 0, indexi = 0;
 
     for(vector<string>::iterator samp = samples.begin(); samp != samples.end(); samp++){
 
       string sampleName = (*samp);
      
-      if(it.find(index) != it.end() ){
+      if(targetMember[index]){
 	target_h.push_back(indexi);
 	indexi++;
       }
-      if(ib.find(index) != ib.end()){
+      if(backgroundMember[index]){
 	background_h.push_back(indexi);
 	indexi++;
       }
@@ -345,13 +408,42 @@ int main(int argc, char** argv) {
     vector<long int> positions;
     vector<double>   afs;
 
-    string haplotypes [nsamples][2];    
+    // the contig's haplotypes, the sites they use and their coordinates
+
+    haplotypeMatrix haplotypes;
+    haplotypes.setHaplotypes(2 * indexi);
+
+    vector<int> targetHaps, backgroundHaps;
+
+    for(unsigned int i = 0; i < target_h.size(); i++){
+      targetHaps.push_back(2 * target_h[i]);
+      targetHaps.push_back(2 * target_h[i] + 1);
+    }
+    for(unsigned int i = 0; i < background_h.size(); i++){
+      backgroundHaps.push_back(2 * background_h[i]);
+      backgroundHaps.push_back(2 * background_h[i] + 1);
+    }
+
+    vector<double> coordinates;
     
     string currentSeqid = "NA";
     
+    // the sample groups and populations are reused at every site
+
+    vector< map< string, vector<string> > * > target, background, total;
+
+    genotype * populationTarget     = newGenotype(format);
+    genotype * populationBackground = newGenotype(format);
+    genotype * populationTotal      = newGenotype(format);
+
+    // the phaser buffers each contig when --phase is given
+
+    lsPhaser phaser(format);
+    phaser.setStates(states);
+
     while (variantFile.getNextVariant(var)) {
 
-      if(!var.isPhased()){
+      if(!phase && !var.isPhased()){
 	cerr <<"FATAL: Found an unphased variant. All genotypes must be phased!" << endl;
 	printHelp();
 	return(1);
@@ -362,59 +454,44 @@ int main(int argc, char** argv) {
       }
 
       if(currentSeqid != var.sequenceName){
-	if(haplotypes[0][0].length() > 10){
-	  calc(haplotypes, nsamples, positions, afs, target_h, background_h, currentSeqid);
+	if(phase){
+	  loadPhaser(haplotypes, phaser);
 	}
-	clearHaplotypes(haplotypes, nsamples);
+	if(haplotypes.nsites > 10){
+	  siteCoordinates(gmap, physical, currentSeqid, positions, coordinates);
+	  calc(haplotypes, positions, afs, coordinates, targetHaps, backgroundHaps, maxExtend, currentSeqid);
+	}
+	haplotypes.clear();
 	positions.clear();
 	currentSeqid = var.sequenceName;
 	afs.clear();
       }
       
-      vector < map< string, vector<string> > > target, background, total;
+      target.clear();
+      background.clear();
+      total.clear();
       
       int sindex = 0;
 
       for(int nsamp = 0; nsamp < nsamples; nsamp++){
 
-	map<string, vector<string> > sample = var.samples[ samples[nsamp]];
+	map<string, vector<string> > & sample = var.samples[ samples[nsamp]];
       	  
-	if(it.find(sindex) != it.end() ){
-	  target.push_back(sample);
-	  total.push_back(sample);	  
+	if(targetMember[sindex]){
+	  target.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
-	if(ib.find(sindex) != ib.end()){
-	  background.push_back(sample);
-	  total.push_back(sample);	  
+	if(backgroundMember[sindex]){
+	  background.push_back(&sample);
+	  total.push_back(&sample);	  
 	}
 	
 	sindex += 1;
       }
       
-      genotype * populationTarget    ;
-      genotype * populationBackground;
-      genotype * populationTotal     ;
-      
-      if(type == "PL"){
-	populationTarget     = new pl();
-	populationBackground = new pl();
-	populationTotal      = new pl();
-      }
-      if(type == "GL"){
-	populationTarget     = new gl();
-	populationBackground = new gl();
-	populationTotal      = new gl();
-      }
-      if(type == "GP"){
-	populationTarget     = new gp();
-	populationBackground = new gp();
-	populationTotal      = new gp();
-      }
-      if(type == "GT"){
-	populationTarget     = new gt();
-        populationBackground = new gt();
-        populationTotal      = new gt();
-      }
+      populationTarget->reset();
+      populationBackground->reset();
+      populationTotal->reset();
       
       populationTarget->loadPop(target,         var.sequenceName, var.position);
       
@@ -433,15 +510,27 @@ int main(int argc, char** argv) {
 
       afs.push_back(populationTotal->af);
       positions.push_back(var.position);
-      loadPhased(haplotypes, populationTotal, nsamples);
+      if(phase){
+	phaser.addSite(populationTotal);
+      }
+      else{
+	loadPhased(haplotypes, populationTotal);
+      }
       
-      delete populationTarget;
-      delete populationBackground;
-      delete populationTotal;
 
     }
 
-    calc(haplotypes, nsamples, positions, afs, target_h, background_h, currentSeqid);
+    if(phase){
+      loadPhaser(haplotypes, phaser);
+    }
+    if(haplotypes.nsites > 0){
+      siteCoordinates(gmap, physical, currentSeqid, positions, coordinates);
+      calc(haplotypes, positions, afs, coordinates, targetHaps, backgroundHaps, maxExtend, currentSeqid);
+    }
     
+    delete populationTarget;
+    delete populationBackground;
+    delete populationTotal;
+
     return 0;		    
 }